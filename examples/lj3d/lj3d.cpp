@@ -2,10 +2,8 @@
 #include <math.h>
 #include "minim.h"
 
-#include <chrono>
 #include <algorithm>
 
-using namespace std::chrono;
 using namespace minim;
 
 int main(int argc, char **argv) {
@@ -38,17 +36,19 @@ int main(int argc, char **argv) {
 
   print();
   print("Measuring minimiser speed...");
-  srand(2);//time(NULL));
+  // Random starts, minimised by every processor independently
   int nruns = 1000;
-  std::vector<double> init(12);
-  auto start = high_resolution_clock::now();
-  for (int i=0; i<nruns; i++) {
-    std::generate(init.begin(), init.end(), [](){ return rand()%1000/100.-5; });
-    state.comm->bcast(init);
-    state.coords(init);
-    auto result = min.minimise(state);
-  }
-  auto stop = high_resolution_clock::now();
-  auto duration = duration_cast<microseconds>(stop - start);
-  print("Time taken by minimiser:", duration.count()/nruns, "microseconds");
+  TaskFarm farm;
+  State farmState(potential, state.coords(), farm.groupRanks());
+  farmState.convergence = 1e-4;
+  farm.setGatherCoords(false);
+  farm.run(farmState, min, nruns, [](int task, State& s) {
+    std::vector<double> init(12);
+    Philox(2, task).uniform(init, -5, 5);
+    s.coords(init);
+  });
+  auto best = std::min_element(farm.results().begin(), farm.results().end(),
+                               [](const TaskFarm::Result& a, const TaskFarm::Result& b) { return a.energy < b.energy; });
+  if (mpi.rank == 0) print("Lowest energy:", best->energy);
+  print("Minimisations per second:", farm.throughput, "on", mpi.size, "processors");
 }
@@ -6,7 +6,10 @@
 #endif
 
 #include <vector>
+#include <string>
 #include <memory>
+#include <utility>
+#include "utils/Stats.h"
 
 namespace minim {
   using std::vector;
@@ -20,6 +23,7 @@ namespace minim {
 
       bool usesThisProc = true;
       vector<int> ranks = vector<int>();
+      Stats* stats = nullptr; //!< Stats of the owning State, used to record the communication (not owned)
 
       int rank() const;
       int size() const;
@@ -37,9 +41,11 @@ namespace minim {
       virtual int getBlock(int loc) const = 0;                  //!< Get the processor that owns a given global index
       virtual int getLocalIdx(int loc, int block=-1) const = 0; //!< Get the local index from a global index, or -1 if not owned by this processor
       double get(const vector<double>& vector, int loc) const;
+      virtual vector<std::pair<int,int>> ownedRanges() const; //!< The [start, end) index ranges owned by this processor (excluding the halo), in order
 
       // Communication
       void communicate(vector<double>& vector) const;
+      void communicate(vector<vector<double>>& vectors) const; //!< Communicate several vectors at once
       void communicateAccumulate(vector<double>& vector) const;
       vector<double> gather(const vector<double>& block, int root=-1) const;
       vector<double> scatter(const vector<double>& data, int root=-1) const;
@@ -48,11 +54,17 @@ namespace minim {
       void bcast(double& value, int root=0) const;
       void bcast(vector<double>& value, int root=0) const;
 
+      // Files
+      void writeFile(const std::string& file, const vector<char>& header, const vector<char>& local) const; //!< Write a header (the same on every processor) and the local data of each processor, collectively without gathering
+      vector<char> readFile(const std::string& file, vector<char>& header) const; //!< Read the header and the local data written by writeFile on the same processors
+
       // MPI reduction functions
       double sum(double a) const;
       double sum(const vector<double>& a) const;
+      vector<double> sumEach(vector<double> a) const; //!< Sum each element across the processors, using a single reduction
       double norm(const vector<double>& a) const;
-      virtual double dotProduct(const vector<double>& a, const vector<double>& b) const;
+      double dotProduct(const vector<double>& a, const vector<double>& b) const;
+      virtual double localDotProduct(const vector<double>& a, const vector<double>& b) const; //!< Dot product of the data owned by this processor (excluding the halo), without a reduction
 
       // Internal functions
       virtual ~Communicator() = default;
@@ -77,12 +89,49 @@ namespace minim {
       std::shared_ptr<MPI_Datatype> blockType;  // MPI derived datatype to send the local block
       std::shared_ptr<MPI_Datatype> gatherType; // MPI derived datatype to receive the blocks for gathering
       static void mpiTypeDeleter(MPI_Datatype* type);
+      long typeBytes(const vector<CommunicateObj>& types) const;
       bool mpiTypesCommitted = false;
       #endif
 
       void defaultSetup(const Potential& pot, size_t ndof, vector<int> ranks);
       void setComm(vector<int> ranks);
       virtual void makeMPITypes() = 0;
+
+      friend class Reduction;
+  };
+
+
+  // Batch of sums across the processors of a communicator, resolved with a single reduction
+  // The reduction can be started without waiting, so that it overlaps local work. The results are only valid after
+  // reduce() or wait(), and no sums can be added while it is in progress.
+  // Usage: Reduction r(comm); int iG2 = r.addDot(g, g); int iE = r.add(e); r.start(); ...; r.wait(); double g2 = r[iG2];
+  class Reduction {
+    public:
+      Reduction(const Communicator& comm);
+      ~Reduction(); //!< Waits for a reduction in progress
+      Reduction(const Reduction&) = delete;
+      Reduction& operator=(const Reduction&) = delete;
+
+      int add(double a); //!< Add the local part of a sum, returning its index
+      int add(const vector<double>& a); //!< Add the local parts of several sums, returning the index of the first
+      int addDot(const vector<double>& a, const vector<double>& b); //!< Add the local dot product (excluding the halo), returning its index
+
+      void reduce(); //!< Sum all of the values
+      void start();  //!< Start summing all of the values without waiting
+      void wait();   //!< Wait for the reduction started by start()
+      void clear();  //!< Remove all of the values, so the object can be reused
+
+      double operator[](int i) const { return _values[i]; };
+      const vector<double>& values() const { return _values; };
+      size_t size() const { return _values.size(); };
+
+    private:
+      const Communicator& _comm;
+      vector<double> _values;
+      bool _pending = false;
+      #ifdef PARALLEL
+      MPI_Request _request = MPI_REQUEST_NULL;
+      #endif
   };
 
 }
@@ -0,0 +1,73 @@
+#ifndef ELEMENTTABLE_H
+#define ELEMENTTABLE_H
+
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include "utils/ArrayView.h"
+
+namespace minim {
+  using std::vector;
+
+
+  // View of a single energy element stored in an ElementTable
+  struct Element {
+    int type;
+    ArrayView<const int> idof;
+    ArrayView<const double> parameters;
+  };
+
+
+  // Owning description of an energy element, used when building an ElementTable
+  struct ElementData {
+    int type;
+    vector<int> idof;
+    vector<double> parameters;
+  };
+
+
+  // Contiguous (CSR) storage of the energy elements
+  // The degrees of freedom and parameters of element i are stored in
+  // idofs[idofStart[i]:idofStart[i+1]] and params[paramStart[i]:paramStart[i+1]]
+  class ElementTable {
+    public:
+      vector<int> types;
+      vector<int> idofStart = {0};
+      vector<int> idofs;
+      vector<int> paramStart = {0};
+      vector<double> params;
+
+      size_t size() const { return types.size(); }
+      bool empty() const { return types.empty(); }
+      void clear();
+      void reserve(size_t nElements, size_t nIdof=0, size_t nParams=0);
+
+      void push_back(const ElementData& el);
+      void push_back(int type, ArrayView<const int> idof, ArrayView<const double> parameters={});
+      void eraseIf(std::function<bool(const Element&)> predicate);
+
+      Element operator[](size_t i) const {
+        return {types[i],
+                {idofs.data()+idofStart[i], (size_t)(idofStart[i+1]-idofStart[i])},
+                {params.data()+paramStart[i], (size_t)(paramStart[i+1]-paramStart[i])}};
+      }
+      ArrayView<int> idof(size_t i) { return {idofs.data()+idofStart[i], (size_t)(idofStart[i+1]-idofStart[i])}; }
+      ArrayView<double> parameters(size_t i) { return {params.data()+paramStart[i], (size_t)(paramStart[i+1]-paramStart[i])}; }
+
+      class Iterator {
+        public:
+          Iterator(const ElementTable* table, size_t i) : _table(table), _i(i) {}
+          Element operator*() const { return (*_table)[_i]; }
+          Iterator& operator++() { _i++; return *this; }
+          bool operator!=(const Iterator& other) const { return _i != other._i; }
+        private:
+          const ElementTable* _table;
+          size_t _i;
+      };
+      Iterator begin() const { return Iterator(this, 0); }
+      Iterator end() const { return Iterator(this, size()); }
+  };
+
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <cmath>
+#include "utils/Stats.h"
+#include "utils/Checkpoint.h"
 
 namespace minim {
   class State;
@@ -14,22 +17,59 @@ namespace minim {
     public:
       int maxIter = 100000;
       std::string linesearch = "backtracking";
+      bool precondition = false;
+      bool pipelined = false;
 
       typedef void (*AdjustFunc)(int, State&);
       int iter;
+      Stats stats; //!< The state stats recorded during the last call to minimise (if enabled in the state)
+
+      // Values at the current coordinates that the minimiser found during the last iteration (NaN if not known)
+      // These are used by the log so that it does not need to evaluate the state
+      struct Progress {
+        double energy = NAN;      //!< Total energy
+        double rmsGradient = NAN; //!< Root mean square of the (constrained) gradient
+        double stepSize = NAN;    //!< Norm of the last step
+        size_t version = 0;       //!< State coordinates version the values are for
+      };
+      Progress progress;
+      std::function<void(const std::string&)> logSink = nullptr; //!< Destination of the predefined log lines (default: print)
+
+      // Checkpointing
+      std::string checkpointFile = "";
+      int checkpointIter = 0;    //!< Write a checkpoint every checkpointIter iterations (0: never)
+      double checkpointTime = 0; //!< Write a checkpoint once this wall time (s) has passed since the last one (0: never)
 
       virtual ~Minimiser() = default;
       virtual std::unique_ptr<Minimiser> clone() const = 0;
 
       virtual Minimiser& setMaxIter(int maxIter);
       Minimiser& setLinesearch(std::string method);
+      Minimiser& setPrecondition(bool precondition); //!< Use the preconditioner of the potential (if it has one), used by Lbfgs, ConjugateGradient and GradDescent
+      Minimiser& setPipelined(bool pipelined); //!< Overlap the global reductions with computation, used by Lbfgs, ConjugateGradient (with the Wolfe linesearch) and NewtonCG
+      Minimiser& setLogSink(std::function<void(const std::string&)> logSink); //!< Send the log lines elsewhere, e.g. to an AsyncLog (only called on rank 0)
+      Minimiser& setCheckpoint(std::string file, int everyIter, double everySeconds=0); //!< Periodically write the coordinates and internal state while minimising, to continue later with resume()
 
-      std::vector<double> minimise(State& state, std::function<void(int,State&)> adjustState=nullptr); //!< Minimise a state with an optional function to be run each iteration.
-      std::vector<double> minimise(State& state, std::string logType); //!< Minimise with a predefined log function. Format: [fields]-[iter]
+      std::vector<double> minimise(State& state, std::function<void(int,State&)> adjustState=nullptr); //!< Minimise a state with an optional function to be run each iteration, which may change the coordinates or the potential (the cached evaluations are cleared after it)
+      std::vector<double> minimise(State& state, std::string logType); //!< Minimise with a predefined log function. Format: [fields]-[iter], with fields e (energy), g (rms gradient), d (step size), s (stats)
+      std::vector<double> resume(State& state, std::string file, std::function<void(int,State&)> adjustState=nullptr); //!< Continue a minimisation from a checkpoint written on the same processors, with the same parameters
+      std::vector<double> resume(State& state, std::string file, std::string logType);
+      void checkpoint(const State& state, std::string file) const; //!< Write the coordinates and internal state now (called on every processor of the state)
 
       virtual void init(State& state) {};
       virtual void iteration(State& state) = 0;
       virtual bool checkConvergence(const State& state) { return false; };
+
+      // The internal state needed to continue after the last iteration, in addition to the coordinates (not the
+      // parameters). This is local to each processor, and may be empty if the iterations only depend on the coordinates.
+      virtual void writeCheckpoint(Checkpoint& out) const;
+      virtual void readCheckpoint(Checkpoint& in);
+
+    private:
+      std::vector<double> run(State& state, std::function<void(int,State&)> adjustState, std::function<void(int,State&)> log,
+                              std::string resumeFile);
+      std::function<void(int,State&)> logFunction(State& state, std::string logType);
+      Checkpoint restore(State& state, std::string file);
   };
 
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include "ElementTable.h"
 
 namespace minim {
   class State;
@@ -32,6 +33,22 @@ namespace minim {
       virtual vector<double> gradient(const vector<double>& coords) const;
       virtual void energyGradient(const vector<double>& coords, const Communicator& comm, double* e, vector<double>* g) const;
       // Note: In any derived classes, either energyGradient or (energy and gradient) MUST be overridden
+      // Note: energyGradient should overwrite g in place (e.g. g->assign) so that the caller's storage is reused
+
+      // Evaluate several sets of coordinates together, e and g must have one entry per set
+      // By default each set is evaluated in turn, potentials can override this to reuse data across the sets
+      virtual void batchEnergyGradient(const vector2d<double>& coords, const Communicator& comm, vector<double>* e, vector2d<double>* g) const;
+
+      // Hessian-vector products, hv = H v at the given coordinates (hv is overwritten)
+      // Potentials with an analytic Hessian override hasHessian and either hessianVector (SERIAL / GRID) or
+      // elementHessianVector (UNSTRUCTURED). Otherwise State uses a finite difference of the gradient.
+      virtual bool hasHessian() const { return false; };
+      virtual void hessianVector(const vector<double>& coords, const vector<double>& v, const Communicator& comm, vector<double>* hv) const {};
+
+      // Preconditioning, z = M^-1 r for an approximation M of the Hessian (z is overwritten)
+      // r and z are on the processor (including the halo). M must be symmetric positive definite.
+      virtual bool hasPreconditioner() const { return false; };
+      virtual void precondition(const vector<double>& coords, const vector<double>& r, const Communicator& comm, vector<double>* z) const {};
 
       State newState(int ndof, const vector<int>& ranks={});
       State newState(const vector<double>& coords, const vector<int>& ranks={});
@@ -82,20 +99,23 @@ namespace minim {
       // UNSTRUCTURED: Energy elements for parallelisation
       bool distributed = false;
 
-      struct Element {
-        int type;
-        vector<int> idof;
-        vector<double> parameters;
-      };
-      vector<Element> elements;
-      vector<Element> elements_halo;
-      Potential& setElements(vector<Element> elements);
+      using Element = minim::Element;
+      using ElementData = minim::ElementData;
+      ElementTable elements;
+      ElementTable elements_halo;
+      Potential& setElements(const vector<ElementData>& elements);
       Potential& setElements(vector2d<int> idofs);
       Potential& setElements(vector2d<int> idofs, vector<int> types, vector2d<double> parameters);
 
       virtual void elementEnergyGradient(const vector<double>& coords, const Element& el, double* e, vector<double>* g) const {};
+      // Note: elementEnergyGradient must only write to the gradient at el.idof for threaded evaluation to be safe
+      virtual void elementHessianVector(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const {}; //!< Adds the element contribution to hv
       virtual void blockEnergyGradient(const vector<double>& coords, const Communicator& comm, double* e, vector<double>* g) const {};
 
+      // UNSTRUCTURED and GRID: Threads used within each processor (0 uses the OpenMP default, requires compiling with openmp=1)
+      int nThreads = 1;
+      Potential& setThreads(int nThreads);
+
       // GRID
       int dofPerNode = 1;
       int haloWidth = 1;
@@ -116,7 +136,7 @@ namespace minim {
         return std::make_unique<Derived>(static_cast<const Derived&>(*this));
       }
 
-      Derived& setElements(vector<Element> elements) {
+      Derived& setElements(const vector<ElementData>& elements) {
         return static_cast<Derived&>(Potential::setElements(elements));
       }
       Derived& setElements(vector2d<int> idofs) {
@@ -126,6 +146,10 @@ namespace minim {
         return static_cast<Derived&>(Potential::setElements(idofs, types, parameters));
       }
 
+      Derived& setThreads(int nThreads) {
+        return static_cast<Derived&>(Potential::setThreads(nThreads));
+      }
+
       Derived& setConstraints(vector<int> iFix) {
         return static_cast<Derived&>(Potential::setConstraints(iFix));
       }
@@ -6,6 +6,7 @@
 #include <cstddef>
 #include "Potential.h"
 #include "Communicator.h"
+#include "utils/Stats.h"
 
 namespace minim {
   class Potential;
@@ -18,6 +19,7 @@ namespace minim {
       std::unique_ptr<Potential> pot;
       std::unique_ptr<Communicator> comm;
       bool usesThisProc = true;
+      mutable Stats stats; //!< Hot path counters and timers, set stats.enabled to record them
 
 
       State(const Potential& pot, const vector<double>& coords, const vector<int>& ranks={});
@@ -37,12 +39,14 @@ namespace minim {
       // Coordinates
       double operator[](int i);
       vector<double> coords() const;
-      void coords(const vector<double>& in);
+      void coords(vector<double> in); //!< Set the coordinates (pass an rvalue to avoid a copy)
 
       // Parallel functions
       const vector<double>& blockCoords() const;
-      void blockCoords(const vector<double>& in);
+      void blockCoords(vector<double> in); //!< Set the local coordinates (pass an rvalue to avoid a copy)
+      vector<double>& editBlockCoords(); //!< Modify the local coordinates in place (the cache is invalidated by this call, so do not keep the reference across evaluations)
 
+      // The *EnergyGradient functions write into the given gradient, reusing its storage
       double blockEnergy() const;
       double blockEnergy(const vector<double>& coords) const;
       vector<double> blockGradient() const;
@@ -62,6 +66,19 @@ namespace minim {
       void allEnergyGradient(double* e, vector<double>* g) const;
       vector<double> allCoords() const;
 
+      // Batched energy / gradient of several sets of processor coordinates (as blockCoords)
+      // Returns the total energies and the processor gradients (including the halo)
+      vector<double> batchEnergy(const vector2d<double>& coords) const;
+      void batchEnergyGradient(const vector2d<double>& coords, vector<double>* e, vector2d<double>* g) const;
+
+      // Hessian-vector product at the current coordinates
+      // The analytic Hessian of the potential is used if available, otherwise a central difference of the gradient
+      vector<double> hessianVector(const vector<double>& v) const; //!< v and the result are global
+      void procHessianVector(const vector<double>& v, vector<double>* hv) const; //!< v and hv are on the processor (including the halo)
+
+      // Apply the preconditioner of the potential, z = M^-1 r (the identity if the potential does not have one)
+      void procPrecondition(const vector<double>& r, vector<double>* z) const; //!< r and z are on the processor (including the halo)
+
       double componentEnergy(int component) const;
 
       void communicate();
@@ -73,7 +90,28 @@ namespace minim {
       bool isFailed = false;
       void failed();
 
-      vector<double> _coords;
+      // Evaluation cache
+      // Evaluations at the current coordinates are stored and reused until the coordinates are changed
+      // Only the energy is kept by default. Setting cacheGradient also keeps a copy of the processor gradient, which
+      // costs an extra vector and a copy per evaluation, but avoids recomputing it if it is requested again.
+      bool cacheGradient = false;
+      size_t coordsVersion() const { return _coordsVersion; }
+      void clearCache() const; //!< Call this if the potential is modified after an evaluation
+
+      vector<double> _coords; //!< Modify using coords() or blockCoords() so that the cache is updated
+
+    private:
+      struct Cache {
+        size_t version = 0;
+        bool hasEnergy = false;
+        bool hasGradient = false;
+        double energy; // Processor energy (not summed)
+        vector<double> gradient; // Processor gradient (including the halo)
+      };
+      size_t _coordsVersion = 0;
+      mutable Cache _cache;
+
+      void cachedEnergyGradient(double* e, vector<double>* g) const;
   };
 
 }
@@ -0,0 +1,80 @@
+/**
+ * \file TaskFarm.h
+ *
+ * This file contains the class for running many independent minimisations on groups of processors.
+ */
+
+#ifndef TASKFARM_H
+#define TASKFARM_H
+
+#include <vector>
+#include <functional>
+
+namespace minim {
+  using std::vector;
+  class State;
+  class Minimiser;
+
+
+  //! \class TaskFarm
+  //! Runs many small independent minimisations (e.g. random starts or parameter sweeps), with the processors split
+  //! into equal groups that each minimise one task at a time. The state must be created using groupRanks().
+  //! The load is balanced dynamically: rank 0 hands out the chunks of tasks in order. The leader of each other group
+  //! keeps a request for its next chunk open (a point-to-point message answered by rank 0), so that the reply arrives
+  //! while it works, and shares each chunk with the rest of its group. Rank 0 also minimises tasks, so it only answers
+  //! the requests (and receives the results) between its own tasks, and a long task on rank 0 delays the other groups.
+  //! The chunks shrink as the queue empties (guided scheduling), so that there are few requests at the start and the
+  //! groups finish together.
+  //! The results are sent to rank 0 as they are found, where they can be handled incrementally with onResult.
+  //! Usage:
+  //!   TaskFarm farm(groupSize);
+  //!   State state = pot.newState(init, farm.groupRanks());
+  //!   farm.run(state, Lbfgs(), nTask, [](int task, State& s){ s.coords(...); });
+  //!   print(farm.throughput, "minimisations per second");
+  class TaskFarm {
+    public:
+      struct Result {
+        int task;
+        double energy;
+        int iter;
+        vector<double> coords; //!< Final coordinates (empty if not gathered)
+      };
+      using Setup = std::function<void(int task, State& state)>;       //!< Set the state for a task (called on every processor of the group)
+      using Callback = std::function<void(const Result& result)>;
+
+      TaskFarm(int groupSize=1);
+
+      int chunk = 1;             //!< Minimum number of tasks taken by a group at once
+      bool gatherCoords = true;  //!< Send the final coordinates to rank 0 (false: only the energies)
+      bool keepResults = true;   //!< Store the results on rank 0 (false: they are only passed to onResult)
+      Callback onResult = nullptr; //!< Called on rank 0 as each result arrives
+
+      TaskFarm& setChunk(int chunk);
+      TaskFarm& setGatherCoords(bool gatherCoords);
+      TaskFarm& setKeepResults(bool keepResults);
+      TaskFarm& setOnResult(Callback onResult);
+
+      int nGroup() const;
+      int group() const; //!< The group of this processor
+      vector<int> groupRanks() const; //!< The processors in the group of this processor, used to create its state
+
+      void run(State& state, const Minimiser& min, int nTask, Setup setup); //!< Must be called on all processors
+      void run(State& state, const Minimiser& min, const vector<vector<double>>& inits); //!< One task for each set of initial coordinates
+
+      // Results
+      const vector<Result>& results() const { return _results; }; //!< Results in task order (rank 0)
+      int nTask;         //!< Number of tasks in the last run
+      int nLocal;        //!< Number of tasks minimised by the group of this processor
+      double elapsed;    //!< Wall time of the last run (s)
+      double throughput; //!< Minimisations per second over all groups
+
+    private:
+      int _groupSize;
+      vector<Result> _results;
+
+      void addResult(Result result);
+  };
+
+}
+
+#endif
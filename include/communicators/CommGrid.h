@@ -8,6 +8,8 @@
 namespace minim {
   using std::vector;
 
+  vector<int> assignCommArray(int commSize, vector<int> globalSizes); //!< The default number of processors along each dimension
+
   class CommGrid : public Communicator {
     public:
       // Assign data
@@ -22,9 +24,10 @@ namespace minim {
       // Access data
       int getBlock(int loc) const override;
       int getLocalIdx(int loc, int block=-1) const override;
+      vector<std::pair<int,int>> ownedRanges() const override;
 
       // MPI reduction functions
-      double dotProduct(const vector<double>& a, const vector<double>& b) const override;
+      double localDotProduct(const vector<double>& a, const vector<double>& b) const override;
 
       // Internal functions
       CommGrid(int haloWidth);
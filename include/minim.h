@@ -8,12 +8,18 @@
 #include "State.h"
 #include "Minimiser.h"
 #include "Potential.h"
+#include "TaskFarm.h"
 
 #include "minimisers/GradDescent.h"
 #include "minimisers/Lbfgs.h"
+#include "minimisers/NewtonCG.h"
+#include "minimisers/ConjugateGradient.h"
 #include "minimisers/Fire.h"
 #include "minimisers/Anneal.h"
+#include "minimisers/ParallelTempering.h"
+#include "minimisers/BasinHopping.h"
 
+#include "potentials/FunctionPotential.h"
 #include "potentials/LjNd.h"
 #include "potentials/BarAndHinge.h"
 #include "potentials/PhaseField.h"
@@ -21,3 +27,5 @@
 
 #include "utils/mpi.h"
 #include "utils/print.h"
+#include "utils/AsyncLog.h"
+#include "utils/Philox.h"
@@ -3,8 +3,10 @@
 
 #include <vector>
 #include "Minimiser.h"
+#include "utils/Philox.h"
 
 namespace minim {
+  class Potential;
 
   class Anneal : public NewMinimiser<Anneal> {
     public:
@@ -15,11 +17,21 @@ namespace minim {
       double tempInit;
       double coolingRate = 1;
       std::function<double(int)> coolingSchedule = nullptr;
+      unsigned seed = 0; //!< Seed for the random numbers, which are reproducible for a given seed and number of processors
+                         //!< Each call to minimise continues the random numbers of the last one instead of replaying them (setSeed restarts them)
 
       Anneal& setDisplacement(double displacement);
       Anneal& setTempInit(double tempInit);
       Anneal& setCoolingRate(double coolingRate);
       Anneal& setCoolingSchedule(std::function<double(int)> coolingSchedule);
+      Anneal& setSeed(unsigned seed);
+
+      // Local moves (UNSTRUCTURED potentials only)
+      // Each iteration proposes a single degree of freedom move for every degree of freedom on the processor, and only
+      // the elements containing the moved degree of freedom are evaluated. Constrained degrees of freedom are not moved,
+      // and potentials with system-wide energy terms (blockEnergyGradient) are not supported.
+      bool localMoves = false;
+      Anneal& setLocalMoves(bool localMoves);
 
       // Convergence parameters
       int maxRejections = 0;
@@ -31,14 +43,31 @@ namespace minim {
       void init(State& state);
       void iteration(State& state);
       bool checkConvergence(const State& state) override;
+      void writeCheckpoint(Checkpoint& out) const override;
+      void readCheckpoint(Checkpoint& in) override;
 
     private:
       int _sinceAccepted;
       double _temp;
       double _currentE;
       std::vector<double> _currentState;
+      Philox _moveRng;   // Different on every processor
+      Philox _acceptRng; // Shared by the processors of the state, unless using local moves
+      uint32_t _stepStart = 0; // Random number step of the first iteration of this call to minimise
+      uint32_t _nStep = 0;     // Random number steps used by all calls since the seed was set
+      std::vector<double> _random;
+
+      // Local moves: elements containing each degree of freedom (CSR, indices past the local elements are halo elements)
+      std::vector<int> _adjStart;
+      std::vector<int> _adjElements;
+      std::vector<int> _interior; // Degrees of freedom whose elements only contain degrees of freedom in the block
+      std::vector<int> _boundary;
 
-      bool acceptMetropolis(double energy);
+      bool acceptMetropolis(double de);
+      void initLocalMoves(const State& state);
+      void localIteration(State& state);
+      int localSweep(const Potential& pot, const std::vector<int>& dofs);
+      double dofEnergy(const Potential& pot, int i) const;
   };
 
 }
@@ -0,0 +1,113 @@
+/**
+ * \file BasinHopping.h
+ *
+ * This file contains the class for the basin-hopping global optimisation algorithm.
+ */
+
+#ifndef BASINHOPPING_H
+#define BASINHOPPING_H
+
+#ifdef PARALLEL
+#include <mpi.h>
+#endif
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "Minimiser.h"
+#include "utils/Philox.h"
+
+namespace minim {
+  using std::vector;
+
+
+  //! \class BasinHopping
+  //! Basin-hopping global optimisation, with independent walkers run on disjoint groups of processors.
+  //! Each iteration perturbs the walker's current minimum, minimises it with the local minimiser, and accepts the new
+  //! minimum with the Metropolis criterion. The processors are split into nWalker equal groups, and each state must be
+  //! created using walkerRanks().
+  //! Every walker keeps a database of the distinct minima it has found, hashed by energy and compared using a
+  //! permutation invariant fingerprint. Each new minimum is first found with a looser convergence, and if it is
+  //! already in the database the final minimisation is skipped. The lowest energy of all walkers is shared with a
+  //! non-blocking reduction that overlaps the next local minimisation, and at the end every walker is set to the
+  //! lowest energy configuration.
+  class BasinHopping : public NewMinimiser<BasinHopping> {
+    public:
+      using Fingerprint = std::function<vector<double>(const vector<double>&)>;
+
+      struct Minimum {
+        double energy;
+        vector<double> fingerprint;
+        vector<double> coords; //!< The coordinates on this processor (as blockCoords)
+        int visits = 1;
+      };
+
+      BasinHopping(const Minimiser& local, double temperature, double displacement, int nWalker=0); //!< nWalker=0: one walker per processor
+      BasinHopping(const BasinHopping& other);
+      BasinHopping& operator=(const BasinHopping& other);
+
+      double temperature;
+      double displacement;
+      unsigned seed = 0; //!< Each call to minimise continues the random numbers of the last one instead of replaying them (setSeed restarts them)
+      double screening = 10;     //!< Convergence of the first minimisation relative to the state convergence (1: no screening)
+      double energyTol = 1e-6;   //!< Energy difference below which two minima may be the same
+      double fingerprintTol = 1e-3; //!< Maximum fingerprint difference for two minima to be the same
+      Fingerprint fingerprint = nullptr; //!< Fingerprint of the global coordinates (none: minima are compared by energy only)
+
+      BasinHopping& setMaxIter(int maxIter);
+      BasinHopping& setTemperature(double temperature);
+      BasinHopping& setDisplacement(double displacement);
+      BasinHopping& setSeed(unsigned seed);
+      BasinHopping& setScreening(double screening);
+      BasinHopping& setTolerances(double energyTol, double fingerprintTol);
+      BasinHopping& setFingerprint(Fingerprint fingerprint);
+
+      static Fingerprint particleFingerprint(int nDim); //!< Sorted distances of the particles from their centroid
+
+      int nWalker() const { return _nWalker; };
+      int walker() const; //!< The walker run by this processor
+      vector<int> walkerRanks() const; //!< The processors running the walker of this processor, used to create its state
+
+      // Results
+      double bestEnergy; //!< Lowest energy found by any walker (updated one iteration behind until the end)
+      int nQuench;       //!< Number of local minimisations by this walker
+      int nDuplicate;    //!< Number of minimisations ending in a minimum already in the database
+      const vector<Minimum>& minima() const { return _minima; }; //!< Distinct minima found by this walker
+
+      void init(State& state);
+      void iteration(State& state);
+
+    private:
+      std::unique_ptr<Minimiser> _local;
+      int _nWalker;
+      int _groupSize;
+      double _currentE;
+      vector<double> _current;
+      vector<double> _best;
+      double _walkerBestE;
+      Philox _moveRng;   // Different on every processor
+      Philox _acceptRng; // Shared by the processors of a walker
+      uint32_t _stepStart = 0; // Random number step of the first iteration of this call to minimise
+      uint32_t _nStep = 0;     // Random number steps used by all calls since the seed was set
+
+      vector<Minimum> _minima;
+      std::unordered_map<long long, vector<int>> _index; // Minima in each energy bin of width energyTol
+
+#ifdef PARALLEL
+      struct { double e; int walker; } _bestSend, _bestRecv;
+      MPI_Request _bestRequest = MPI_REQUEST_NULL;
+#endif
+
+      int quench(State& state);
+      vector<double> getFingerprint(const State& state) const;
+      int findMinimum(double energy, const vector<double>& fp) const;
+      int addMinimum(double energy, vector<double> fp, const vector<double>& coords);
+      void startBestReduction();
+      void finishBestReduction();
+      void shareBest(State& state);
+  };
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * \file ConjugateGradient.h
+ *
+ * This file contains the class for the nonlinear conjugate gradient algorithm.
+ */
+
+#ifndef CONJUGATEGRADIENT_H
+#define CONJUGATEGRADIENT_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include "Minimiser.h"
+
+namespace minim {
+  using std::vector;
+  class Reduction;
+
+
+  //! \class ConjugateGradient
+  //! Nonlinear conjugate gradient minimisation algorithm
+  //! Only three work vectors are stored besides the coordinates (the gradient, the new gradient and the direction,
+  //! compared to 2m+3 for L-BFGS), so this is suited to very large systems. The default Wolfe line search moves the
+  //! coordinates in place, while the backtracking line search uses one more for the trial coordinates.
+  //! Two more are used with a preconditioner.
+  //! The direction is restarted along the steepest descent direction every restart interval, or if it is not downhill.
+  class ConjugateGradient : public NewMinimiser<ConjugateGradient> {
+    public:
+      ConjugateGradient();
+
+      ConjugateGradient& setMaxIter(int maxIter);
+      ConjugateGradient& setMethod(std::string method); //!< Update formula: "hz" (Hager-Zhang, default) or "pr+" (Polak-Ribiere+)
+      ConjugateGradient& setRestart(int restart); //!< Iterations between restarts (0: number of degrees of freedom)
+      ConjugateGradient& setMaxStep(double maxStep);
+
+      void init(State& state);
+      void iteration(State& state);
+
+      bool checkConvergence(const State& state) override;
+      void writeCheckpoint(Checkpoint& out) const override;
+      void readCheckpoint(Checkpoint& in) override;
+
+    private:
+      std::string _method = "hz";
+      int _restart = 0;
+      double _init_step = 1e-3;
+      double _maxStep = 0;
+      vector<double> _g;
+      vector<double> _gNew;
+      vector<double> _p; //!< The search direction, which is scaled to give the step taken
+      vector<double> _z; //!< Preconditioned gradient (only used with a preconditioner)
+      vector<double> _zNew;
+      vector<std::pair<int,int>> _owned;
+
+      double _g2; //!< Squared norm of the current gradient
+      double _gz; //!< Dot product of the current gradient with the preconditioned gradient
+      double _gp; //!< Directional derivative along the search direction
+      double _scale; //!< Initial step multiplier of the search direction
+      int _nRestart;
+
+      void directionDots(Reduction& sums, double a);
+      void updateDirection(const vector<double>& dots, double gs, double alpha);
+  };
+
+}
+
+#endif
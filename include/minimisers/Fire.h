@@ -2,9 +2,12 @@
 #define FIRE_H
 
 #include <vector>
+#include <string>
+#include <utility>
 #include "Minimiser.h"
 
 namespace minim {
+  class Communicator;
 
   class Fire : public NewMinimiser<Fire> {
     public:
@@ -15,10 +18,13 @@ namespace minim {
 
       Fire& setMaxIter(int maxIter);
       Fire& setDtMax(double dtMax);
+      Fire& setMethod(std::string method); //!< "fire" (default) or "fire2" (FIRE 2.0: semi-implicit Euler with the inertia correction, does not use a linesearch)
 
       void init(State& state);
       void iteration(State& state);
       bool checkConvergence(const State& state) override;
+      void writeCheckpoint(Checkpoint& out) const override;
+      void readCheckpoint(Checkpoint& in) override;
 
     private:
       int _nMin = 5;
@@ -26,6 +32,11 @@ namespace minim {
       double _fDec = 0.5;
       double _fA = 0.99;
       double _aStart = 0.1;
+      // FIRE 2.0 (Guenole et al. 2020 use dtMin = 0.02 dtMD and dtMax = 10 dtMD)
+      double _aStart2 = 0.25;
+      int _nDelay = 20;           // Downhill steps before the time step grows, and initial steps before it can shrink
+      double _dtMinRatio = 0.002; // Minimum time step relative to dtMax
+      std::string _method = "fire";
 
       int _nSteps;
       double _a;
@@ -33,6 +44,14 @@ namespace minim {
       double _gNorm;
       std::vector<double> _g;
       std::vector<double> _v;
+
+      // Dot products of the velocity and gradient after the last step
+      double _vv;
+      double _vg;
+      std::vector<std::pair<int,int>> _owned;
+
+      void iterationFire2(State& state);
+      void updateDots(const State& state);
   };
 
 }
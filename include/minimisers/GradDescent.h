@@ -16,10 +16,14 @@ namespace minim {
       void iteration(State& state);
 
       bool checkConvergence(const State& state) override;
+      void writeCheckpoint(Checkpoint& out) const override;
+      void readCheckpoint(Checkpoint& in) override;
 
     private:
       double _alpha = 1e-1;
+      double _g2; // Squared norm of the gradient at the start of the last iteration
       std::vector<double> _g;
+      size_t _gVersion; // Coordinates version of the gradient left by the Wolfe linesearch (0: none)
   };
 
 }
@@ -9,12 +9,14 @@
 #define LBFGS_H
 
 #include <vector>
+#include <utility>
 #include "Minimiser.h"
+#include "utils/AlignedAllocator.h"
 
 namespace minim {
   using std::vector;
   template<typename T> using vector2d = vector<vector<T>>;
-  class Communicator;
+  class Reduction;
 
 
   //! \class Lbfgs
@@ -29,6 +31,8 @@ namespace minim {
       void iteration(State& state);
 
       bool checkConvergence(const State& state) override;
+      void writeCheckpoint(Checkpoint& out) const override;
+      void readCheckpoint(Checkpoint& in) override;
 
     private:
       int _m = 5;
@@ -36,11 +40,36 @@ namespace minim {
       double _init_step = 1e-3;
       double _maxStep = 0;
       vector<double> _g;
+      vector<double> _gNew;
+      vector<double> _step;
       vector<double> _rho;
-      vector2d<double> _s;
-      vector2d<double> _y;
 
-      vector<double> getDirection(const Communicator& comm);
+      // The m most recent (s, y) pairs are stored in a ring of m+1 slots, so that a new pair is always written to a
+      // free slot. The rows (s_0..s_m, y_0..y_m) are stored contiguously in a single aligned buffer.
+      int _nSlot;
+      size_t _stride;
+      vector<double, AlignedAllocator<double>> _history;
+      vector<std::pair<int,int>> _owned;
+      double* sRow(int i) { return &_history[i*_stride]; };
+      double* yRow(int i) { return &_history[(_nSlot+i)*_stride]; };
+
+      // The direction is found as a combination of the basis vectors {s_0..s_m, y_0..y_m, g}, using their dot
+      // products (the Gram matrix), so that only a single reduction is required each iteration
+      vector<double> _gram;
+      vector<double> _delta;
+      int iS(int i) const { return i; };
+      int iY(int i) const { return _nSlot + i; };
+      int iG() const { return 2 * _nSlot; };
+      double& gram(int a, int b) { return _gram[a*(2*_nSlot+1) + b]; };
+      void setGram(int a, int b, double value) { gram(a, b) = value; gram(b, a) = value; };
+
+      vector<double> _z; //!< Preconditioned vector (only used with a preconditioner)
+
+      void getDirection(const State& state, double* gs);
+      void formStep();
+      void preconditionDirection(const State& state, const vector<double>& alpha, double* gs);
+      void historyDots(Reduction& sums, double a);
+      void updateHistory(const vector<double>& dots);
   };
 
 }
@@ -0,0 +1,53 @@
+/**
+ * \file NewtonCG.h
+ *
+ * This file contains the class for the truncated Newton (Newton-CG) algorithm.
+ */
+
+#ifndef NEWTONCG_H
+#define NEWTONCG_H
+
+#include <vector>
+#include "Minimiser.h"
+
+namespace minim {
+  using std::vector;
+  class Communicator;
+
+
+  //! \class NewtonCG
+  //! Matrix-free truncated Newton minimisation algorithm
+  //! Each step approximately solves H p = -g using conjugate gradients with Hessian-vector products
+  //! from the State, stopping early on negative curvature or once the residual is below a forcing term.
+  //! If pipelined, the conjugate gradient reductions overlap the Hessian-vector products.
+  class NewtonCG : public NewMinimiser<NewtonCG> {
+    public:
+      NewtonCG& setMaxIter(int maxIter);
+      NewtonCG& setMaxCGIter(int maxCGIter); //!< Maximum conjugate gradient iterations per step (0: number of degrees of freedom)
+      NewtonCG& setMaxStep(double maxStep);
+
+      void iteration(State& state);
+
+      bool checkConvergence(const State& state) override;
+      void writeCheckpoint(Checkpoint& out) const override;
+      void readCheckpoint(Checkpoint& in) override;
+
+    private:
+      int _maxCGIter = 0;
+      double _maxStep = 0;
+      double _g2; // Squared norm of the gradient
+      vector<double> _g;
+      vector<double> _r;
+      vector<double> _d;
+      vector<double> _hd;
+      vector<double> _w; // Pipelined: H r
+      vector<double> _s; // Pipelined: H d
+      vector<double> _z; // Pipelined: H s
+
+      vector<double> getDirection(State& state);
+      vector<double> getDirectionPipelined(State& state);
+  };
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * \file ParallelTempering.h
+ *
+ * This file contains the class for the replica exchange (parallel tempering) Monte Carlo algorithm.
+ */
+
+#ifndef PARALLELTEMPERING_H
+#define PARALLELTEMPERING_H
+
+#include <vector>
+#include "Minimiser.h"
+#include "utils/Philox.h"
+
+namespace minim {
+  using std::vector;
+
+
+  //! \class ParallelTempering
+  //! Replica exchange Monte Carlo, with each replica run at a different temperature on a disjoint group of processors.
+  //! The processors are split into nReplica equal groups, and each state must be created using replicaRanks().
+  //! Neighbouring temperatures attempt to swap configurations every exchange interval, using point-to-point messages
+  //! between the corresponding processors of the two groups. At the end, every replica is set to the lowest energy
+  //! configuration found by any of them.
+  class ParallelTempering : public NewMinimiser<ParallelTempering> {
+    public:
+      ParallelTempering(double tempMin, double tempMax, double displacement, int nReplica=0); //!< nReplica=0: one replica per processor
+
+      double displacement;
+      vector<double> temperatures; //!< Temperature of each replica (geometric ladder by default)
+      int exchangeInterval = 10;
+      unsigned seed = 0; //!< Each call to minimise continues the random numbers of the last one instead of replaying them (setSeed restarts them)
+
+      ParallelTempering& setMaxIter(int maxIter);
+      ParallelTempering& setDisplacement(double displacement);
+      ParallelTempering& setTemperatures(vector<double> temperatures);
+      ParallelTempering& setExchangeInterval(int exchangeInterval);
+      ParallelTempering& setSeed(unsigned seed);
+
+      int nReplica() const { return temperatures.size(); };
+      int replica() const; //!< The replica run by this processor
+      vector<int> replicaRanks() const; //!< The processors running the replica of this processor, used to create its state
+
+      // Results
+      double bestEnergy; //!< Lowest energy found by any replica
+      int nExchange; //!< Number of accepted exchanges involving this replica
+      int nExchangeAttempt;
+
+      void init(State& state);
+      void iteration(State& state);
+
+    private:
+      int _groupSize;
+      double _currentE;
+      vector<double> _current;
+      vector<double> _best;
+      Philox _moveRng;     // Different on every processor
+      Philox _acceptRng;   // Shared by the processors of a replica
+      Philox _exchangeRng; // Shared by all processors
+      uint32_t _stepStart = 0; // Random number step of the first iteration of this call to minimise
+      uint32_t _nStep = 0;     // Random number steps used by all calls since the seed was set
+
+      void exchange(State& state);
+      void shareBest(State& state);
+  };
+
+}
+
+#endif
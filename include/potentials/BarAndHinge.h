@@ -16,6 +16,8 @@ namespace minim {
       void init(const vector<double>& coords) override;
 
       void elementEnergyGradient(const vector<double>& coords, const Element& el, double* e, vector<double>* g) const override;
+      bool hasHessian() const override { return true; };
+      void elementHessianVector(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const override;
 
       BarAndHinge& setTriangulation(const vector2d<int>& triList);
       BarAndHinge& setBondList(const vector2d<int>& bondList);
@@ -66,6 +68,10 @@ namespace minim {
       void bending(const vector<double>& coords, const Element& el, double* e, vector<double>* g) const;
       void forceEnergy(const vector<double>& coords, const Element& el, double* e, vector<double>* g) const;
       void substrate(const vector<double>& coords, const Element& el, double* e, vector<double>* g) const;
+
+      void stretchingHessian(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const;
+      void bendingHessian(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const;
+      void substrateHessian(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const;
   };
 
 }
@@ -0,0 +1,67 @@
+#ifndef FUNCTIONPOTENTIAL_H
+#define FUNCTIONPOTENTIAL_H
+
+#include <vector>
+#include <utility>
+#include "Potential.h"
+
+namespace minim {
+  using std::vector;
+
+
+  //! Serial potential defined by a (fused) energy and gradient callable, e.g. a lambda with captures.
+  //! The callable has the signature void(const vector<double>& coords, double* e, vector<double>* g),
+  //! where either of e or g may be null. It is stored by value, so the calls can be inlined.
+  template<typename EGFn>
+  class FunctionPotential : public NewPotential<FunctionPotential<EGFn>> {
+    public:
+      FunctionPotential(EGFn energyGradient) : _energyGradient(std::move(energyGradient)) {};
+
+      double energy(const vector<double>& coords) const override {
+        double e;
+        _energyGradient(coords, &e, nullptr);
+        return e;
+      }
+
+      vector<double> gradient(const vector<double>& coords) const override {
+        vector<double> g;
+        _energyGradient(coords, nullptr, &g);
+        return g;
+      }
+
+      void energyGradient(const vector<double>& coords, const Communicator& comm, double* e, vector<double>* g) const override {
+        _energyGradient(coords, e, g);
+      }
+
+    private:
+      EGFn _energyGradient;
+  };
+
+
+  // Combines separate energy and gradient callables, only calling those that are required
+  template<typename EFn, typename GFn>
+  struct SeparateEnergyGradient {
+    EFn energy;
+    GFn gradient;
+    void operator()(const vector<double>& coords, double* e, vector<double>* g) const {
+      if (e) *e = energy(coords);
+      if (g) *g = gradient(coords);
+    }
+  };
+
+
+  //! Create a potential from a fused energy and gradient callable
+  template<typename EGFn>
+  FunctionPotential<EGFn> makePotential(EGFn energyGradient) {
+    return FunctionPotential<EGFn>(std::move(energyGradient));
+  }
+
+  //! Create a potential from separate energy and gradient callables
+  template<typename EFn, typename GFn>
+  FunctionPotential<SeparateEnergyGradient<EFn,GFn>> makePotential(EFn energy, GFn gradient) {
+    return FunctionPotential<SeparateEnergyGradient<EFn,GFn>>({std::move(energy), std::move(gradient)});
+  }
+
+}
+
+#endif
@@ -24,6 +24,8 @@ namespace minim {
       void init(const vector<double>& coords) override;
 
       void elementEnergyGradient(const vector<double>& coords, const Element& el, double* e, vector<double>* g) const override;
+      bool hasHessian() const override { return true; };
+      void elementHessianVector(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const override;
 
       LjNd& setSigma(double sigma);
       LjNd& setEpsilon(double epsilon);
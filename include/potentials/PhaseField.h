@@ -8,6 +8,7 @@
 
 namespace minim {
   using std::vector;
+  class Minimiser;
 
 
   class PhaseField : public NewPotential<PhaseField> {
@@ -64,15 +65,34 @@ namespace minim {
       PhaseField& setFixFluid(int iFluid, bool fix=true);
       PhaseField& setConfinement(vector<double> strength);
 
+      // Preconditioner
+      // Jacobi sweeps for M z = r, where M contains the gradient energy terms and the bulk curvature at the minima
+      int preconditionerSweeps = 4;
+      PhaseField& setPreconditionerSweeps(int nSweeps);
+
       vector<double> diffuseSolid(vector<char> solid, int iFluid=0, bool twoStep=false);
       static vector<double> diffuseSolid(vector<char> solid, PhaseField potential, int iFluid=0, bool twoStep=false);
       static vector<double> diffuseSolid(vector<char> solid, vector<int> gridSize, int nFluid=2, int iFluid=0, bool twoStep=false);
 
+      // Multilevel minimisation
+      // The system is minimised on successively finer grids, with the result on each interpolated to give the initial
+      // coordinates on the next. Coarse levels use fewer processors if their blocks would be too small.
+      // These use the global parameters, so should be called on the potential used to create the state (not State::pot).
+      PhaseField coarsen() const; //!< Copy of the potential on a grid coarsened by a factor of two (the grid sizes must be even)
+      vector<double> restrictCoords(const vector<double>& coords) const; //!< Average the coordinates onto the coarsened grid
+      vector<double> prolongCoords(const vector<double>& coarseCoords) const; //!< Linearly interpolate the coordinates from the coarsened grid
+      State multilevelMinimise(const vector<double>& coords, Minimiser& minimiser, int nLevels=0, vector<int> ranks={}) const; //!< nLevels=0: Coarsen while the grid sizes are even and at least 8
+
       // Overrides
       void init(const vector<double>& coords) override;
       void initLocal(const vector<double>& coords, const Communicator& comm) override;
 
       void energyGradient(const vector<double>& coords, const Communicator& comm, double* e, vector<double>* g) const override;
+      void batchEnergyGradient(const vector2d<double>& coords, const Communicator& comm, vector<double>* e, vector2d<double>* g) const override;
+      bool hasHessian() const override { return true; };
+      void hessianVector(const vector<double>& coords, const vector<double>& v, const Communicator& comm, vector<double>* hv) const override;
+      bool hasPreconditioner() const override { return model==MODEL_BASIC && preconditionerSweeps>0; };
+      void precondition(const vector<double>& coords, const vector<double>& r, const Communicator& comm, vector<double>* z) const override;
 
       std::map<std::string,vector<double>> energyComponents(const vector<double>& coords, const Communicator& comm) const;
 
@@ -110,6 +130,9 @@ namespace minim {
                          const vector<int>& neighbours, double factor, double* e, vector<double>* g) const;
       void phasePairGradient(const vector<double>& coords, int iGrid, int iFluid1, int iFluid2, const vector<int>& xGrid,
                              const vector<int>& neighbours, double factor, double* e, vector<double>* g) const;
+      void phaseDiagonal(int iGrid, int iFluid, const vector<int>& neighbours, double factor, vector<double>& diag) const;
+
+      void sweepEnergyGradient(int nSets, const vector<double>* const* coords, double* e, vector<double>* const* g) const;
 
       void fluidEnergy(const vector<double>& coords, int iNode, const vector<int>& xGrid, double* e, vector<double>* g) const;
       void fluidPairEnergy(const vector<double>& coords, int iNode, const vector<int>& xGrid, double* e, vector<double>* g) const;
@@ -118,6 +141,11 @@ namespace minim {
       void surfaceEnergy(const vector<double>& coords, int iNode, double* e, vector<double>* g) const;
       void forceEnergy(const vector<double>& coords, int iNode, const vector<int>& xGrid, double* e, vector<double>* g) const;
       void ffConfinementEnergy(const vector<double>& coords, int iNode, double* e, vector<double>* g) const;
+      void nodeHessianVector(const vector<double>& coords, const vector<double>& v, int iNode, const vector<int>& xGrid, vector<double>* hv) const;
+
+      mutable vector<double> precondDiag; //!< Built on the first call to precondition
+      void precondCoefficients(int iGrid, int iFluid, double* bulk, double* grad) const;
+      void precondOperator(const vector<double>& v, vector<double>* mv) const;
       vector<bool> volumeConstraintEnergy(const vector<double>& coords, const Communicator& comm, double* e, vector<double>* g) const;
       void specialisedConstraints(const vector<double>& coords, const Communicator& comm, vector<double>& data) const override;
   };
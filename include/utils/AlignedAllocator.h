@@ -0,0 +1,35 @@
+#ifndef MINIM_ALIGNEDALLOCATOR_H
+#define MINIM_ALIGNEDALLOCATOR_H
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+namespace minim {
+
+  // Allocator for std::vector with storage aligned to a cache line
+  template<typename T, size_t Align=64>
+  struct AlignedAllocator {
+    using value_type = T;
+    template<typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t n) {
+      void* ptr = nullptr;
+      if (posix_memalign(&ptr, Align, n*sizeof(T)) != 0) throw std::bad_alloc();
+      return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) { free(ptr); }
+  };
+
+  template<typename T, typename U, size_t Align>
+  bool operator==(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&) { return true; }
+  template<typename T, typename U, size_t Align>
+  bool operator!=(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&) { return false; }
+
+}
+
+#endif
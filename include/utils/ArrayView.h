@@ -0,0 +1,38 @@
+#ifndef MINIM_ARRAYVIEW_H
+#define MINIM_ARRAYVIEW_H
+
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+namespace minim {
+
+  // Non-owning view of a contiguous array
+  template<typename T>
+  class ArrayView {
+    using value_type = std::remove_const_t<T>;
+
+    public:
+      ArrayView() : _data(nullptr), _size(0) {}
+      ArrayView(T* data, size_t size) : _data(data), _size(size) {}
+      ArrayView(std::vector<value_type>& vec) : _data(vec.data()), _size(vec.size()) {}
+      template<typename U=T, typename=std::enable_if_t<std::is_const<U>::value>>
+      ArrayView(const std::vector<value_type>& vec) : _data(vec.data()), _size(vec.size()) {}
+      template<typename U=T, typename=std::enable_if_t<std::is_const<U>::value>>
+      ArrayView(const ArrayView<value_type>& other) : _data(other.data()), _size(other.size()) {}
+
+      T& operator[](size_t i) const { return _data[i]; }
+      T* data() const { return _data; }
+      T* begin() const { return _data; }
+      T* end() const { return _data + _size; }
+      size_t size() const { return _size; }
+      bool empty() const { return _size == 0; }
+
+    private:
+      T* _data;
+      size_t _size;
+  };
+
+}
+
+#endif
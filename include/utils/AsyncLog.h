@@ -0,0 +1,27 @@
+#ifndef MINIM_ASYNCLOG_H
+#define MINIM_ASYNCLOG_H
+
+#include <string>
+#include <memory>
+#include <iostream>
+
+namespace minim {
+
+  // Log sink that writes lines from a background thread, so that the minimisation does not wait for the output
+  // Copies share the same thread and queue. The lines are written in order, and any still queued are written when
+  // the last copy is destroyed.
+  // Usage: AsyncLog log(file); min.setLogSink(log).minimise(state, "eg-10");
+  class AsyncLog {
+    public:
+      AsyncLog(std::ostream& out=std::cout); //!< out must outlive the log
+      void operator()(const std::string& line) const; //!< Queue a line
+      void flush() const; //!< Wait until all queued lines have been written
+
+    private:
+      struct Impl;
+      std::shared_ptr<Impl> _impl;
+  };
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MINIM_CHECKPOINT_H
+#define MINIM_CHECKPOINT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace minim {
+
+  // Binary buffer for the coordinates and internal state of a minimiser on one processor
+  // Values are read back in the order they were written. Vectors are stored as their length followed by the raw
+  // elements, so the data is only portable between runs on the same kind of machine.
+  // Usage: out.write(_i).write(_g); ... in.read(_i).read(_g);
+  class Checkpoint {
+    public:
+      std::vector<char> data;
+
+      Checkpoint() = default;
+      Checkpoint(std::vector<char> data) : data(std::move(data)) {};
+
+      template<typename T>
+      Checkpoint& write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Checkpoint: Only trivially copyable values can be written.");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        data.insert(data.end(), bytes, bytes+sizeof(T));
+        return *this;
+      }
+
+      template<typename T, typename A>
+      Checkpoint& write(const std::vector<T,A>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "Checkpoint: Only trivially copyable values can be written.");
+        write<uint64_t>(values.size());
+        const char* bytes = reinterpret_cast<const char*>(values.data());
+        data.insert(data.end(), bytes, bytes+values.size()*sizeof(T));
+        return *this;
+      }
+
+      template<typename T>
+      Checkpoint& read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Checkpoint: Only trivially copyable values can be read.");
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return *this;
+      }
+
+      template<typename T, typename A>
+      Checkpoint& read(std::vector<T,A>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "Checkpoint: Only trivially copyable values can be read.");
+        uint64_t n;
+        read(n);
+        values.resize(n);
+        if (n > 0) std::memcpy(values.data(), take(n*sizeof(T)), n*sizeof(T));
+        return *this;
+      }
+
+      bool finished() const { return _pos == data.size(); }; //!< Whether all of the data has been read
+
+    private:
+      size_t _pos = 0;
+
+      const char* take(size_t n) {
+        if (_pos + n > data.size()) throw std::invalid_argument("Checkpoint: Read past the end of the data.");
+        const char* bytes = &data[_pos];
+        _pos += n;
+        return bytes;
+      }
+  };
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef MINIM_PHILOX_H
+#define MINIM_PHILOX_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace minim {
+
+  // Counter-based random number generator (Philox4x32-10, Salmon et al. 2011)
+  // Each block of four numbers is a function of the key (the seed) and a 128 bit counter, made from the stream and
+  // substream (e.g. the rank and thread, or what the numbers are used for), the step (e.g. the iteration) and the
+  // block within the step. Different streams are independent, and the numbers for a step do not depend on how many
+  // were drawn before it, so parallel runs are reproducible without any shared state.
+  class Philox {
+    public:
+      using result_type = uint32_t;
+      using Block = std::array<uint32_t,4>;
+      using Key = std::array<uint32_t,2>;
+
+      Philox(uint64_t seed=0, uint32_t stream=0, uint32_t subStream=0);
+
+      Philox& setStep(uint32_t step); //!< Move to the start of the numbers for a step
+
+      result_type operator()(); //!< Next 32 bit integer (satisfies UniformRandomBitGenerator)
+      static constexpr result_type min() { return 0; }
+      static constexpr result_type max() { return UINT32_MAX; }
+
+      double uniform(); //!< Uniform in [0, 1), with 53 random bits
+      void uniform(double* out, size_t n, double lo=0, double hi=1); //!< Fill out with uniforms in [lo, hi)
+      void uniform(std::vector<double>& out, double lo=0, double hi=1) { uniform(out.data(), out.size(), lo, hi); }
+
+      static Block block(Block counter, Key key); //!< The Philox4x32-10 bijection
+
+    private:
+      Key _key;
+      Block _counter; // {block, step, stream, subStream}
+      Block _buffer;
+      int _used = 4; // Numbers of the buffer already returned
+  };
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef MINIM_STATS_H
+#define MINIM_STATS_H
+
+#include <string>
+#include <memory>
+#include <chrono>
+
+namespace minim {
+
+  // Counters and wall times for the hot paths of a State (evaluations, communication, constraints, linesearch)
+  // Nothing is recorded unless enabled, so the only overhead when disabled is a branch per call
+  class Stats {
+    public:
+      enum Phase {
+        POTENTIAL,   //!< Potential kernels (energy / gradient evaluations)
+        CONSTRAINTS, //!< Applying the constraints
+        HALO,        //!< Halo exchanges (Communicator::communicate)
+        ACCUMULATE,  //!< Edge accumulation (Communicator::communicateAccumulate)
+        REDUCE,      //!< Allreductions (sums and dot products)
+        GATHER,      //!< Gathers and broadcasts
+        LINESEARCH,  //!< Linesearches (includes the evaluations made within them)
+        ITERATION,   //!< Minimiser iterations (includes all of the above)
+        NPHASE
+      };
+      static const char* phaseName(Phase phase);
+
+      bool enabled = false;
+      long nEnergy = 0;       //!< Number of energy evaluations
+      long nGradient = 0;     //!< Number of gradient evaluations
+      long nHessian = 0;      //!< Number of Hessian-vector products
+      long nCalls[NPHASE] = {};
+      double time[NPHASE] = {}; //!< Wall time (s)
+      long bytes = 0;         //!< Bytes sent by this processor in halo exchanges, accumulations and reductions
+      long cycles = 0;        //!< CPU cycles in the potential kernels (hardware counters only)
+      long cacheMisses = 0;   //!< Cache misses in the potential kernels (hardware counters only)
+
+      void reset();
+      bool enableHardwareCounters(); //!< Count cycles and cache misses in the potential kernels using perf_event_open (Linux only). Returns false if unavailable.
+      std::string str() const;      //!< One line summary, used by the "s" log field
+
+      void evaluation(bool e, bool g, long n=1) {
+        if (!enabled) return;
+        if (e) nEnergy += n;
+        if (g) nGradient += n;
+      }
+      void hessian() {
+        if (enabled) nHessian++;
+      }
+      void addBytes(long n) {
+        if (enabled) bytes += n;
+      }
+
+      Stats& operator-=(const Stats& other);
+
+      // Scoped timer for a phase, the stats may be null
+      class Timer {
+        public:
+          Timer(Stats* stats, Phase phase) : _stats((stats && stats->enabled) ? stats : nullptr), _phase(phase) {
+            if (_stats) start();
+          }
+          ~Timer() { if (_stats) stop(); }
+          Timer(const Timer&) = delete;
+          Timer& operator=(const Timer&) = delete;
+        private:
+          Stats* _stats;
+          Phase _phase;
+          std::chrono::steady_clock::time_point _start;
+          long _hwStart[2];
+          void start();
+          void stop();
+      };
+
+    private:
+      struct HardwareCounters;
+      std::shared_ptr<HardwareCounters> _hw;
+  };
+
+}
+
+#endif
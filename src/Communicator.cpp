@@ -1,6 +1,10 @@
 #include "Communicator.h"
 
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
 #include <numeric>
+#include <algorithm>
 #include <stdexcept>
 #include "Potential.h"
 #include "utils/vec.h"
@@ -36,10 +40,18 @@ namespace minim {
   }
 
 
+  vector<std::pair<int,int>> Communicator::ownedRanges() const {
+    if (!usesThisProc) return {};
+    return {{0, (int)nproc}};
+  }
+
+
   //===== Communicate =====//
   void Communicator::communicate(vector<double>& vector) const {
     if (!usesThisProc || commSize==1) return;
     #ifdef PARALLEL
+    Stats::Timer timer(stats, Stats::HALO);
+    if (stats && stats->enabled) stats->addBytes(typeBytes(haloTypes));
     int nRequest = haloTypes.size() + edgeTypes.size();
     MPI_Request requests[nRequest];
     int iRequest = 0;
@@ -53,11 +65,34 @@ namespace minim {
     #endif
   }
 
+  void Communicator::communicate(vector2d<double>& vectors) const {
+    // Communicate several vectors with a single wait, so that the latency is only paid once
+    if (!usesThisProc || commSize==1) return;
+    #ifdef PARALLEL
+    Stats::Timer timer(stats, Stats::HALO);
+    if (stats && stats->enabled) stats->addBytes(vectors.size() * typeBytes(haloTypes));
+    int nRequest = vectors.size() * (haloTypes.size() + edgeTypes.size());
+    vector<MPI_Request> requests(nRequest);
+    int iRequest = 0;
+    for (auto& vector : vectors) {
+      for (const auto& sendType : haloTypes) {
+        MPI_Isend(&vector[0], 1, *sendType.type, sendType.rank, sendType.tag, comm, &requests[iRequest++]);
+      }
+      for (const auto& recvType : edgeTypes) {
+        MPI_Irecv(&vector[0], 1, *recvType.type, recvType.rank, recvType.tag, comm, &requests[iRequest++]);
+      }
+    }
+    MPI_Waitall(nRequest, requests.data(), MPI_STATUSES_IGNORE);
+    #endif
+  }
+
   void Communicator::communicateAccumulate(vector<double>& data) const {
     // Adds the halo values onto the corresponding block locations.
     // This is used to accumulate contributions to the gradient from neighbouring processors.
     if (!usesThisProc || commSize==1) return;
     #ifdef PARALLEL
+    Stats::Timer timer(stats, Stats::ACCUMULATE);
+    if (stats && stats->enabled) stats->addBytes(typeBytes(edgeTypes));
     MPI_Win win;
     MPI_Win_create(data.data(), data.size()*sizeof(double), sizeof(double), MPI_INFO_NULL, comm, &win);
 
@@ -82,6 +117,7 @@ namespace minim {
     if (commSize == 1) return block;
 
   #ifdef PARALLEL
+    Stats::Timer timer(stats, Stats::GATHER);
     vector<double> gathered;
     if (root == -1) {
       gathered = vector<double>(ndof);
@@ -124,7 +160,10 @@ namespace minim {
   void Communicator::bcast(int& value, int root) const {
     if (!usesThisProc) return;
   #ifdef PARALLEL
-    if (commSize > 1) MPI_Bcast(&value, 1, MPI_INT, root, comm);
+    if (commSize > 1) {
+      Stats::Timer timer(stats, Stats::GATHER);
+      MPI_Bcast(&value, 1, MPI_INT, root, comm);
+    }
   #endif
   }
 
@@ -132,7 +171,10 @@ namespace minim {
   void Communicator::bcast(double& value, int root) const {
     if (!usesThisProc) return;
   #ifdef PARALLEL
-    if (commSize > 1) MPI_Bcast(&value, 1, MPI_DOUBLE, root, comm);
+    if (commSize > 1) {
+      Stats::Timer timer(stats, Stats::GATHER);
+      MPI_Bcast(&value, 1, MPI_DOUBLE, root, comm);
+    }
   #endif
   }
 
@@ -140,8 +182,132 @@ namespace minim {
   void Communicator::bcast(vector<double>& vector, int root) const {
     if (!usesThisProc) return;
   #ifdef PARALLEL
-    if (commSize > 1) MPI_Bcast(&vector[0], vector.size(), MPI_DOUBLE, root, comm);
+    if (commSize > 1) {
+      Stats::Timer timer(stats, Stats::GATHER);
+      MPI_Bcast(&vector[0], vector.size(), MPI_DOUBLE, root, comm);
+    }
+  #endif
+  }
+
+
+  //===== Files =====//
+  // The file contains the header size and number of processors, the header, the size of the data of each processor,
+  // then the data in rank order. Each processor writes its own size and data at an offset found with a prefix sum.
+  // The file is written under a temporary name and renamed once complete, so that an interrupted write (e.g. at a
+  // wall-clock limit) leaves the previous file intact.
+  void Communicator::writeFile(const std::string& file, const vector<char>& header, const vector<char>& local) const {
+    if (!usesThisProc) return;
+    std::string tmp = file + ".tmp";
+    uint64_t prefix[2] = {header.size(), (uint64_t)commSize};
+    uint64_t size = local.size();
+    uint64_t tableStart = sizeof(prefix) + header.size();
+    uint64_t dataStart = tableStart + commSize*sizeof(uint64_t);
+
+  #ifdef PARALLEL
+    if (commSize > 1) {
+      uint64_t offset = 0;
+      MPI_Exscan(&size, &offset, 1, MPI_UINT64_T, MPI_SUM, comm);
+      if (commRank == 0) offset = 0; // The result of the exclusive scan is undefined on the first processor
+
+      MPI_File fh;
+      if (MPI_File_open(comm, tmp.c_str(), MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        throw std::invalid_argument("Communicator: Unable to open "+tmp+" for writing.");
+      }
+      MPI_File_set_size(fh, 0);
+      if (commRank == 0) {
+        MPI_File_write_at(fh, 0, prefix, sizeof(prefix), MPI_BYTE, MPI_STATUS_IGNORE);
+        MPI_File_write_at(fh, sizeof(prefix), header.data(), header.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+      }
+      MPI_File_write_at(fh, tableStart + commRank*sizeof(uint64_t), &size, sizeof(size), MPI_BYTE, MPI_STATUS_IGNORE);
+      MPI_File_write_at_all(fh, dataStart + offset, local.data(), local.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+      MPI_File_close(&fh);
+
+      int renamed = (commRank == 0) ? (std::rename(tmp.c_str(), file.c_str()) == 0) : 0;
+      MPI_Bcast(&renamed, 1, MPI_INT, 0, comm);
+      if (!renamed) throw std::invalid_argument("Communicator: Unable to rename "+tmp+" to "+file+".");
+      return;
+    }
   #endif
+
+    // A single processor, or a serial potential where every processor has the same data and only the first writes
+    enum { WRITTEN, WRITE_FAILED, RENAME_FAILED };
+    int status = WRITTEN;
+    if (mpi.rank == ranks[0]) {
+      std::ofstream out(tmp, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+      out.write(header.data(), header.size());
+      out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      out.write(local.data(), local.size());
+      out.close();
+      if (!out) {
+        status = WRITE_FAILED;
+      } else if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+        status = RENAME_FAILED;
+      }
+    }
+  #ifdef PARALLEL
+    // The other processors wait for the file, so that it can be read as soon as this returns
+    if (ranks.size() > 1) {
+      MPI_Group worldGroup, group;
+      MPI_Comm ranksComm;
+      MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+      MPI_Group_incl(worldGroup, ranks.size(), ranks.data(), &group);
+      MPI_Comm_create_group(MPI_COMM_WORLD, group, 0, &ranksComm);
+      MPI_Bcast(&status, 1, MPI_INT, 0, ranksComm); // ranks[0] is the first processor of the group
+      MPI_Comm_free(&ranksComm);
+      MPI_Group_free(&group);
+      MPI_Group_free(&worldGroup);
+    }
+  #endif
+    if (status == WRITE_FAILED) throw std::invalid_argument("Communicator: Unable to write "+tmp+".");
+    if (status == RENAME_FAILED) throw std::invalid_argument("Communicator: Unable to rename "+tmp+" to "+file+".");
+  }
+
+
+  vector<char> Communicator::readFile(const std::string& file, vector<char>& header) const {
+    if (!usesThisProc) return vector<char>();
+    uint64_t prefix[2];
+    vector<uint64_t> sizes(commSize);
+    vector<char> local;
+
+  #ifdef PARALLEL
+    if (commSize > 1) {
+      MPI_File fh;
+      if (MPI_File_open(comm, file.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        throw std::invalid_argument("Communicator: Unable to open "+file+" for reading.");
+      }
+      MPI_File_read_at_all(fh, 0, prefix, sizeof(prefix), MPI_BYTE, MPI_STATUS_IGNORE);
+      if (prefix[1] != (uint64_t)commSize) {
+        MPI_File_close(&fh);
+        throw std::invalid_argument("Communicator: "+file+" was written by a different number of processors.");
+      }
+      header.resize(prefix[0]);
+      MPI_File_read_at_all(fh, sizeof(prefix), header.data(), header.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+      uint64_t tableStart = sizeof(prefix) + header.size();
+      MPI_File_read_at_all(fh, tableStart, sizes.data(), commSize*sizeof(uint64_t), MPI_BYTE, MPI_STATUS_IGNORE);
+      uint64_t offset = std::accumulate(sizes.begin(), sizes.begin()+commRank, (uint64_t)0);
+      local.resize(sizes[commRank]);
+      MPI_File_read_at_all(fh, tableStart + commSize*sizeof(uint64_t) + offset, local.data(), local.size(),
+                           MPI_BYTE, MPI_STATUS_IGNORE);
+      MPI_File_close(&fh);
+      return local;
+    }
+  #endif
+
+    std::ifstream in(file, std::ios::binary);
+    if (!in) throw std::invalid_argument("Communicator: Unable to open "+file+" for reading.");
+    in.read(reinterpret_cast<char*>(prefix), sizeof(prefix));
+    if (!in) throw std::invalid_argument("Communicator: "+file+" is incomplete.");
+    if (prefix[1] != 1) {
+      throw std::invalid_argument("Communicator: "+file+" was written by a different number of processors.");
+    }
+    header.resize(prefix[0]);
+    in.read(header.data(), header.size());
+    in.read(reinterpret_cast<char*>(sizes.data()), sizeof(uint64_t));
+    local.resize(sizes[0]);
+    in.read(local.data(), local.size());
+    if (!in) throw std::invalid_argument("Communicator: "+file+" is incomplete.");
+    return local;
   }
 
 
@@ -150,7 +316,11 @@ namespace minim {
     if (!usesThisProc) return 0;
     double result = a;
   #ifdef PARALLEL
-    if (commSize > 1) MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_DOUBLE, MPI_SUM, comm);
+    if (commSize > 1) {
+      Stats::Timer timer(stats, Stats::REDUCE);
+      if (stats) stats->addBytes(sizeof(double));
+      MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_DOUBLE, MPI_SUM, comm);
+    }
   #endif
     return result;
   }
@@ -161,6 +331,19 @@ namespace minim {
   }
 
 
+  vector<double> Communicator::sumEach(vector<double> a) const {
+    if (!usesThisProc) return vector<double>(a.size(), 0);
+  #ifdef PARALLEL
+    if (commSize > 1) {
+      Stats::Timer timer(stats, Stats::REDUCE);
+      if (stats) stats->addBytes(a.size() * sizeof(double));
+      MPI_Allreduce(MPI_IN_PLACE, a.data(), a.size(), MPI_DOUBLE, MPI_SUM, comm);
+    }
+  #endif
+    return a;
+  }
+
+
   double Communicator::norm(const vector<double>& a) const {
     if (!usesThisProc) return 0;
     return sqrt(dotProduct(a, a));
@@ -169,7 +352,79 @@ namespace minim {
 
   double Communicator::dotProduct(const vector<double>& a, const vector<double>& b) const {
     if (!usesThisProc) return 0;
-    return sum(std::inner_product(a.begin(), a.end(), b.begin(), 0.0));
+    return sum(localDotProduct(a, b));
+  }
+
+
+  double Communicator::localDotProduct(const vector<double>& a, const vector<double>& b) const {
+    if (!usesThisProc) return 0;
+    return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+  }
+
+
+  //===== Batched reductions =====//
+  Reduction::Reduction(const Communicator& comm) : _comm(comm) {}
+
+
+  Reduction::~Reduction() {
+    if (_pending) wait();
+  }
+
+
+  int Reduction::add(double a) {
+    if (_pending) throw std::logic_error("Reduction: Cannot add a value while the reduction is in progress.");
+    _values.push_back(a);
+    return _values.size() - 1;
+  }
+
+
+  int Reduction::add(const vector<double>& a) {
+    if (_pending) throw std::logic_error("Reduction: Cannot add a value while the reduction is in progress.");
+    _values.insert(_values.end(), a.begin(), a.end());
+    return _values.size() - a.size();
+  }
+
+
+  int Reduction::addDot(const vector<double>& a, const vector<double>& b) {
+    return add(_comm.localDotProduct(a, b));
+  }
+
+
+  void Reduction::reduce() {
+    start();
+    wait();
+  }
+
+
+  void Reduction::start() {
+    if (_pending) throw std::logic_error("Reduction: The reduction is already in progress.");
+    if (!_comm.usesThisProc) {
+      std::fill(_values.begin(), _values.end(), 0);
+      return;
+    }
+  #ifdef PARALLEL
+    if (_comm.commSize > 1 && !_values.empty()) {
+      if (_comm.stats) _comm.stats->addBytes(_values.size() * sizeof(double));
+      MPI_Iallreduce(MPI_IN_PLACE, _values.data(), _values.size(), MPI_DOUBLE, MPI_SUM, _comm.comm, &_request);
+      _pending = true;
+    }
+  #endif
+  }
+
+
+  void Reduction::wait() {
+    if (!_pending) return;
+  #ifdef PARALLEL
+    Stats::Timer timer(_comm.stats, Stats::REDUCE); // Only the time spent waiting is recorded
+    MPI_Wait(&_request, MPI_STATUS_IGNORE);
+  #endif
+    _pending = false;
+  }
+
+
+  void Reduction::clear() {
+    wait();
+    _values.clear();
   }
 
 
@@ -181,6 +436,17 @@ namespace minim {
     if (*type!=MPI_DATATYPE_NULL) MPI_Type_free(type);
     delete type;
   }
+
+  // Total size of the data sent using a set of datatypes
+  long Communicator::typeBytes(const vector<CommunicateObj>& types) const {
+    long bytes = 0;
+    for (const auto& type : types) {
+      int size;
+      MPI_Type_size(*type.type, &size);
+      bytes += size;
+    }
+    return bytes;
+  }
   #endif
 
 
@@ -0,0 +1,65 @@
+#include "ElementTable.h"
+
+namespace minim {
+  using std::vector;
+
+
+  void ElementTable::clear() {
+    types.clear();
+    idofStart = {0};
+    idofs.clear();
+    paramStart = {0};
+    params.clear();
+  }
+
+
+  void ElementTable::reserve(size_t nElements, size_t nIdof, size_t nParams) {
+    types.reserve(nElements);
+    idofStart.reserve(nElements+1);
+    paramStart.reserve(nElements+1);
+    idofs.reserve(nIdof);
+    params.reserve(nParams);
+  }
+
+
+  void ElementTable::push_back(const ElementData& el) {
+    push_back(el.type, el.idof, el.parameters);
+  }
+
+  void ElementTable::push_back(int type, ArrayView<const int> idof, ArrayView<const double> parameters) {
+    types.push_back(type);
+    idofs.insert(idofs.end(), idof.begin(), idof.end());
+    params.insert(params.end(), parameters.begin(), parameters.end());
+    idofStart.push_back(idofs.size());
+    paramStart.push_back(params.size());
+  }
+
+
+  void ElementTable::eraseIf(std::function<bool(const Element&)> predicate) {
+    // Compact the arrays in place, keeping the order of the remaining elements
+    size_t nKeep = 0;
+    int idofEnd = 0;
+    int paramEnd = 0;
+    for (size_t i=0; i<size(); i++) {
+      int idofBegin = idofStart[i];
+      int paramBegin = paramStart[i];
+      int nIdof = idofStart[i+1] - idofBegin;
+      int nParam = paramStart[i+1] - paramBegin;
+      if (predicate((*this)[i])) continue;
+      types[nKeep] = types[i];
+      for (int j=0; j<nIdof; j++) idofs[idofEnd+j] = idofs[idofBegin+j];
+      for (int j=0; j<nParam; j++) params[paramEnd+j] = params[paramBegin+j];
+      idofEnd += nIdof;
+      paramEnd += nParam;
+      nKeep++;
+      idofStart[nKeep] = idofEnd;
+      paramStart[nKeep] = paramEnd;
+    }
+    types.resize(nKeep);
+    idofStart.resize(nKeep+1);
+    paramStart.resize(nKeep+1);
+    idofs.resize(idofEnd);
+    params.resize(paramEnd);
+  }
+
+}
@@ -1,5 +1,7 @@
 #include "Minimiser.h"
 
+#include <chrono>
+#include <typeinfo>
 #include <stdexcept>
 #include <sstream>
 #include <iomanip>
@@ -16,28 +18,167 @@ namespace minim {
   }
 
   Minimiser& Minimiser::setLinesearch(std::string method) {
-    if (!vec::isIn({"backtracking","none"}, method)) {
+    if (!vec::isIn({"backtracking","wolfe","none"}, method)) {
       throw std::invalid_argument("Invalid line search method.");
     }
     linesearch = method;
     return *this;
   }
 
+  Minimiser& Minimiser::setPrecondition(bool precondition) {
+    this->precondition = precondition;
+    return *this;
+  }
+
+
+  Minimiser& Minimiser::setPipelined(bool pipelined) {
+    this->pipelined = pipelined;
+    return *this;
+  }
+
+
+  Minimiser& Minimiser::setLogSink(std::function<void(const std::string&)> logSink) {
+    this->logSink = logSink;
+    return *this;
+  }
+
+
+  Minimiser& Minimiser::setCheckpoint(std::string file, int everyIter, double everySeconds) {
+    if (file.empty()) throw std::invalid_argument("Minimiser: The checkpoint file name must not be empty.");
+    if (everyIter < 0 || everySeconds < 0) {
+      throw std::invalid_argument("Minimiser: The checkpoint interval must not be negative.");
+    }
+    checkpointFile = file;
+    checkpointIter = everyIter;
+    checkpointTime = everySeconds;
+    return *this;
+  }
+
 
   std::vector<double> Minimiser::minimise(State& state, std::function<void(int,State&)> adjustState) {
+    return run(state, adjustState, nullptr, "");
+  }
+
+
+  std::vector<double> Minimiser::minimise(State& state, std::string logType) {
+    return run(state, nullptr, logFunction(state, logType), "");
+  }
+
+
+  std::vector<double> Minimiser::resume(State& state, std::string file, std::function<void(int,State&)> adjustState) {
+    return run(state, adjustState, nullptr, file);
+  }
+
+
+  std::vector<double> Minimiser::resume(State& state, std::string file, std::string logType) {
+    return run(state, nullptr, logFunction(state, logType), file);
+  }
+
+
+  std::vector<double> Minimiser::run(State& state, std::function<void(int,State&)> adjustState,
+                                    std::function<void(int,State&)> log, std::string resumeFile) {
     if (!state.usesThisProc) return std::vector<double>();
 
+    Stats start = state.stats;
+    progress = Progress();
+    Checkpoint saved;
+    if (!resumeFile.empty()) saved = restore(state, resumeFile); // Sets the coordinates and the last iteration
     init(state);
-    for (iter=0; iter<=maxIter; iter++) {
-      if (adjustState) adjustState(iter, state);
-      iteration(state);
-      if (checkConvergence(state)) break;
+    if (!resumeFile.empty()) readCheckpoint(saved);
+    int iStart = (resumeFile.empty()) ? 0 : iter+1;
+
+    // The wall time of the first processor decides when to write a checkpoint. Its decision is shared without
+    // waiting, so it is used one iteration later and all processors write together without an extra reduction.
+    bool checkpointing = !checkpointFile.empty() && (checkpointIter > 0 || checkpointTime > 0);
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    Reduction timeUp(*state.comm);
+
+    for (iter=iStart; iter<=maxIter; iter++) {
+      if (adjustState) {
+        adjustState(iter, state);
+        state.clearCache(); // The function may change the potential as well as the coordinates
+        progress = Progress();
+      }
+      if (log) log(iter, state);
+      progress = Progress();
+      {
+        Stats::Timer timer(&state.stats, Stats::ITERATION);
+        iteration(state);
+      }
+      bool converged = checkConvergence(state);
+      progress.version = state.coordsVersion();
+      if (converged) break;
+
+      if (!checkpointing) continue;
+      bool due = (checkpointIter > 0 && (iter+1) % checkpointIter == 0);
+      if (checkpointTime > 0) {
+        timeUp.wait();
+        if (timeUp.size() > 0 && timeUp[0] > 0) due = true;
+      }
+      if (due) {
+        checkpoint(state, checkpointFile);
+        lastCheckpoint = std::chrono::steady_clock::now();
+      }
+      if (checkpointTime > 0) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastCheckpoint).count();
+        timeUp.clear();
+        timeUp.add((state.comm->rank() == 0 && elapsed > checkpointTime) ? 1 : 0);
+        timeUp.start();
+      }
     }
+    stats = state.stats;
+    stats -= start;
     return state.coords();
   }
 
 
-  std::vector<double> Minimiser::minimise(State& state, std::string logType) {
+  void Minimiser::checkpoint(const State& state, std::string file) const {
+    if (!state.usesThisProc) return;
+    std::string type = typeid(*this).name();
+    Checkpoint header, local;
+    header.write(std::vector<char>(type.begin(), type.end())).write<uint64_t>(state.ndof).write(iter);
+    local.write(state.blockCoords());
+    writeCheckpoint(local);
+    state.comm->writeFile(file, header.data, local.data);
+  }
+
+
+  Checkpoint Minimiser::restore(State& state, std::string file) {
+    // Check that the checkpoint is for the same minimiser and problem
+    std::vector<char> headerData;
+    Checkpoint local = state.comm->readFile(file, headerData);
+    Checkpoint header(std::move(headerData));
+    std::vector<char> type;
+    uint64_t ndof;
+    header.read(type).read(ndof).read(iter);
+    if (std::string(type.begin(), type.end()) != typeid(*this).name()) {
+      throw std::invalid_argument("Minimiser: "+file+" was written by a different minimiser.");
+    }
+    if (ndof != state.ndof) {
+      throw std::invalid_argument("Minimiser: "+file+" has a different number of degrees of freedom.");
+    }
+
+    std::vector<double> coords;
+    local.read(coords);
+    if (coords.size() != state.blockCoords().size()) {
+      throw std::invalid_argument("Minimiser: "+file+" was written with a different decomposition.");
+    }
+    state.blockCoords(std::move(coords)); // Includes the halo
+    return local;
+  }
+
+
+  void Minimiser::writeCheckpoint(Checkpoint& out) const {
+    throw std::invalid_argument("Minimiser: Checkpoints are not supported by this minimiser.");
+  }
+
+
+  void Minimiser::readCheckpoint(Checkpoint& in) {
+    throw std::invalid_argument("Minimiser: Checkpoints are not supported by this minimiser.");
+  }
+
+
+  std::function<void(int,State&)> Minimiser::logFunction(State& state, std::string logType) {
     std::function<void(int,State&)> logFn = nullptr;
 
     // Check if logType in the correct format, [fields]-[iteration]
@@ -48,23 +189,53 @@ namespace minim {
       if (logIter > 0) {
         int iterDigits = std::to_string(maxIter).length();
         // Define the log function
-        logFn = [logIter, logFields, iterDigits](int i, State& s){
+        bool logS = (logFields.find('s') < logFields.length());
+        if (logS) state.stats.enabled = true;
+        logFn = [this, logIter, logFields, iterDigits, logS](int i, State& s){
           if (i%logIter!=0) return;
           bool logE = (logFields.find('e') < logFields.length());
           bool logG = (logFields.find('g') < logFields.length());
-          double e;
-          vector<double> g;
-          s.energyGradient(logE?(&e):nullptr, logG?(&g):nullptr);
+          bool logD = (logFields.find('d') < logFields.length());
+
+          // Use the values found by the minimiser, only evaluating the state (usually from its cache) for the rest
+          bool current = (progress.version == s.coordsVersion());
+          double e = (current) ? progress.energy : NAN;
+          double rms = (current) ? progress.rmsGradient : NAN;
+          bool needE = logE && std::isnan(e);
+          bool needG = logG && std::isnan(rms);
+          if (needE || needG) {
+            double eProc = 0;
+            vector<double> g;
+            // Keep the gradient, as the minimiser usually needs it next (e.g. in the first iteration)
+            bool cacheGradient = s.cacheGradient;
+            s.cacheGradient = true;
+            s.procEnergyGradient(needE ? &eProc : nullptr, needG ? &g : nullptr);
+            s.cacheGradient = cacheGradient;
+            vector<double> sums = s.comm->sumEach({eProc, needG ? s.comm->localDotProduct(g, g) : 0});
+            if (needE) e = sums[0];
+            if (needG) rms = sqrt(sums[1] / s.ndof);
+          }
+
           std::ostringstream log;
           log << "I: " << std::setw(iterDigits) << i;
           if (logE) log << "  E: " << e;
-          if (logG) log << "  G: " << vec::rms(g);
-          print(log.str());
+          if (logG) log << "  G: " << rms;
+          if (logD) {
+            log << "  D: ";
+            if (current && !std::isnan(progress.stepSize)) log << progress.stepSize; else log << "-";
+          }
+          if (logS) log << "  " << s.stats.str();
+          if (mpi.rank != 0) return;
+          if (logSink) {
+            logSink(log.str());
+          } else {
+            print(log.str());
+          }
         };
       }
     }
 
-    return minimise(state, logFn);
+    return logFn;
   }
 
 }
@@ -41,6 +41,13 @@ namespace minim {
   }
 
 
+  void Potential::batchEnergyGradient(const vector2d<double>& coords, const Communicator& comm, vector<double>* e, vector2d<double>* g) const {
+    for (size_t i=0; i<coords.size(); i++) {
+      energyGradient(coords[i], comm, (e) ? &(*e)[i] : nullptr, (g) ? &(*g)[i] : nullptr);
+    }
+  }
+
+
   State Potential::newState(const vector<double>& coords, const vector<int>& ranks) {
     return State(*this, coords, ranks);
   }
@@ -51,27 +58,32 @@ namespace minim {
   }
 
 
-  Potential& Potential::setElements(vector<Element> elements)
-  {
-    this->elements = elements;
+  Potential& Potential::setElements(const vector<ElementData>& elements) {
+    this->elements.clear();
+    this->elements.reserve(elements.size());
+    for (const auto& el: elements) {
+      this->elements.push_back(el);
+    }
     return *this;
   }
 
   Potential& Potential::setElements(vector2d<int> idofs) {
     // Generate energy elements
-    elements = {};
+    elements.clear();
+    elements.reserve(idofs.size());
     for (const auto& idof: idofs) {
-      elements.push_back({0, idof});
+      elements.push_back(0, idof);
     }
     return *this;
   }
 
   Potential& Potential::setElements(vector2d<int> idofs, vector<int> types, vector2d<double> parameters) {
     // Generate energy elements
-    elements = {};
+    elements.clear();
     int nelements = idofs.size();
+    elements.reserve(nelements);
     for (int i=0; i<nelements; i++) {
-      elements.push_back({types[i], idofs[i], parameters[i]});
+      elements.push_back(types[i], idofs[i], parameters[i]);
     }
     return *this;
   }
@@ -162,6 +174,13 @@ namespace minim {
   }
 
 
+  Potential& Potential::setThreads(int nThreads) {
+    if (nThreads < 0) throw std::invalid_argument("The number of threads must not be negative.");
+    if (potentialType() == SERIAL) print("Warning: Threaded evaluation is not used by serial Potential types.");
+    this->nThreads = nThreads;
+    return *this;
+  }
+
   Potential& Potential::setCommArray(vector<int> commArray) {
     if (potentialType() != GRID) print("Warning: Attempting to set communicator array for a non-grid Potential type.");
     this->commArray = commArray;
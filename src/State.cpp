@@ -1,7 +1,13 @@
 #include "State.h"
 
+#include <utility>
+#include <algorithm>
 #include <stdexcept>
+#include "utils/vec.h"
 #include "utils/mpi.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 namespace minim {
@@ -18,6 +24,7 @@ namespace minim {
     // Set-up the communicator
     this->comm = this->pot->newComm();
     this->comm->setup(*this->pot, ndof, ranks);
+    this->comm->stats = &this->stats;
     this->usesThisProc = comm->usesThisProc;
     // Initialise the potential (locally)
     this->pot->initLocal(coords, *comm);
@@ -31,8 +38,12 @@ namespace minim {
       pot(state.pot->clone()),
       comm(state.comm->clone()),
       usesThisProc(state.usesThisProc),
+      stats(state.stats),
+      cacheGradient(state.cacheGradient),
       _coords(state._coords)
-  {}
+  {
+    comm->stats = &stats;
+  }
 
   State& State::operator=(const State& state) {
     ndof = state.ndof;
@@ -40,28 +51,98 @@ namespace minim {
     pot = state.pot->clone();
     comm = state.comm->clone();
     usesThisProc = state.usesThisProc;
+    cacheGradient = state.cacheGradient;
+    stats = state.stats;
+    comm->stats = &stats;
     _coords = state._coords;
+    clearCache(); // The potential has changed
     return *this;
   }
 
 
   inline void basicEG(const Potential& pot, const vector<double>& coords, double* e, vector<double>* g, const Communicator& comm) {
-    pot.energyGradient(coords, comm, e, g);
+    if (comm.stats) comm.stats->evaluation(e, g);
+    {
+      Stats::Timer timer(comm.stats, Stats::POTENTIAL);
+      pot.energyGradient(coords, comm, e, g);
+    }
     if (g) {
       if (comm.size() > 1) comm.communicateAccumulate(*g); // Get correct gradient on the edges
+      Stats::Timer timer(comm.stats, Stats::CONSTRAINTS);
       pot.applyConstraints(coords, comm, *g);
     }
   }
 
+  // The elements are evaluated in fixed size blocks, with the energy of each block summed in order
+  // This makes the energy independent of the number of threads used
+  constexpr int ELEMENT_BLOCK_SIZE = 256;
+
+  inline void elementsEG(const Potential& pot, const vector<double>& coords, double* e, vector<double>* g) {
+    int nElements = pot.elements.size();
+    int nBlocks = (nElements + ELEMENT_BLOCK_SIZE - 1) / ELEMENT_BLOCK_SIZE;
+    auto blockEG = [&](int iBlock, vector<double>* gBlock) {
+      double eBlock = 0;
+      int iEnd = std::min((iBlock+1) * ELEMENT_BLOCK_SIZE, nElements);
+      for (int i=iBlock*ELEMENT_BLOCK_SIZE; i<iEnd; i++) {
+        pot.elementEnergyGradient(coords, pot.elements[i], (e) ? &eBlock : nullptr, gBlock);
+      }
+      return eBlock;
+    };
+
+#ifdef _OPENMP
+    int nThreads = std::min((pot.nThreads == 0) ? omp_get_max_threads() : pot.nThreads, nBlocks);
+    if (nThreads > 1) {
+      vector<double> eBlocks((e) ? nBlocks : 0);
+      vector<vector<double>*> gThreads(nThreads, nullptr);
+      #pragma omp parallel num_threads(nThreads)
+      {
+        // Each thread accumulates its own gradient to avoid conflicts, with the first thread using g directly
+        // The buffers are kept between calls to avoid reallocation
+        static thread_local vector<double> gBuffer;
+        int iThread = omp_get_thread_num();
+        if (g && iThread > 0) {
+          gBuffer.assign(coords.size(), 0);
+          gThreads[iThread] = &gBuffer;
+        }
+        vector<double>* gThread = (iThread > 0) ? gThreads[iThread] : g;
+
+        #pragma omp for schedule(static)
+        for (int iBlock=0; iBlock<nBlocks; iBlock++) {
+          double eBlock = blockEG(iBlock, gThread);
+          if (e) eBlocks[iBlock] = eBlock;
+        }
+
+        // Reduce the gradients in thread order so that the result is deterministic
+        if (g) {
+          int nActive = omp_get_num_threads();
+          #pragma omp for schedule(static)
+          for (int i=0; i<(int)coords.size(); i++) {
+            for (int jThread=1; jThread<nActive; jThread++) (*g)[i] += (*gThreads[jThread])[i];
+          }
+        }
+      }
+      if (e) for (double eBlock : eBlocks) *e += eBlock;
+      return;
+    }
+#endif
+
+    for (int iBlock=0; iBlock<nBlocks; iBlock++) {
+      double eBlock = blockEG(iBlock, g);
+      if (e) *e += eBlock;
+    }
+  }
+
   inline void elementEG(const Potential& pot, const vector<double>& coords, double* e, vector<double>* g, const Communicator& comm) {
+    if (comm.stats) comm.stats->evaluation(e, g);
     if (e) *e = 0;
-    if (g) *g = vector<double>(coords.size());
-    // Compute the energy elements
-    for (auto el : pot.elements) {
-      pot.elementEnergyGradient(coords, el, e, g);
+    if (g) g->assign(coords.size(), 0); // Reuses the existing storage of g
+    {
+      Stats::Timer timer(comm.stats, Stats::POTENTIAL);
+      // Compute the energy elements
+      elementsEG(pot, coords, e, g);
+      // Compute any system-wide contributions
+      pot.blockEnergyGradient(coords, comm, e, g);
     }
-    // Compute any system-wide contributions
-    pot.blockEnergyGradient(coords, comm, e, g);
     if (!g) return;
     // Get the correct gradient on the edges (not halo)
     if (comm.size()>1) {
@@ -73,57 +154,144 @@ namespace minim {
       // }
     }
     // Constraints
+    Stats::Timer timer(comm.stats, Stats::CONSTRAINTS);
     pot.applyConstraints(coords, comm, *g);
   }
 
 
+  // Evaluate the elements for several sets of coordinates, iterating over the sets in the inner loop so that each
+  // element's data is reused. The energies are summed in the same blocks as elementsEG.
+  inline void batchElementEG(const Potential& pot, const vector2d<double>& coords, vector<double>* e, vector2d<double>* g, const Communicator& comm) {
+    int nSets = coords.size();
+    int nElements = pot.elements.size();
+    if (comm.stats) comm.stats->evaluation(e, g, nSets);
+    if (e) e->assign(nSets, 0);
+    if (g) {
+      for (int k=0; k<nSets; k++) (*g)[k].assign(coords[k].size(), 0);
+    }
+
+    {
+      Stats::Timer timer(comm.stats, Stats::POTENTIAL);
+      vector<double> eBlock(nSets);
+      for (int iStart=0; iStart<nElements; iStart+=ELEMENT_BLOCK_SIZE) {
+        std::fill(eBlock.begin(), eBlock.end(), 0);
+        int iEnd = std::min(iStart+ELEMENT_BLOCK_SIZE, nElements);
+        for (int i=iStart; i<iEnd; i++) {
+          Element el = pot.elements[i];
+          for (int k=0; k<nSets; k++) {
+            pot.elementEnergyGradient(coords[k], el, (e) ? &eBlock[k] : nullptr, (g) ? &(*g)[k] : nullptr);
+          }
+        }
+        if (e) for (int k=0; k<nSets; k++) (*e)[k] += eBlock[k];
+      }
+      for (int k=0; k<nSets; k++) {
+        pot.blockEnergyGradient(coords[k], comm, (e) ? &(*e)[k] : nullptr, (g) ? &(*g)[k] : nullptr);
+      }
+    }
+
+    if (!g) return;
+    for (int k=0; k<nSets; k++) {
+      if (comm.size() > 1) comm.communicateAccumulate((*g)[k]);
+      Stats::Timer timer(comm.stats, Stats::CONSTRAINTS);
+      pot.applyConstraints(coords[k], comm, (*g)[k]);
+    }
+  }
+
+
+  // Get the processor coordinates, only scattering (and copying) if given the full set of coordinates
+  inline const vector<double>& localCoords(const vector<double>& coords, size_t ndof, const Communicator& comm, vector<double>& buffer) {
+    if (coords.size() != ndof || comm.size() == 1) return coords;
+    buffer = comm.scatter(coords);
+    return buffer;
+  }
+
+
   // Energy and gradient functions using the state coordinates
+  // These are evaluated at the processor level and the energy is cached, so repeated calls at the same coordinates are
+  // not recomputed. The gradient is written directly into g unless cacheGradient is set, which stores a copy.
+  void State::cachedEnergyGradient(double* e, vector<double>* g) const {
+    if (_cache.version != _coordsVersion) clearCache();
+    bool needE = e && !_cache.hasEnergy;
+    bool needG = g && !_cache.hasGradient;
+    if (needE || needG) {
+      vector<double>* gOut = (!needG) ? nullptr : (cacheGradient) ? &_cache.gradient : g;
+      procEnergyGradient(_coords, needE ? &_cache.energy : nullptr, gOut);
+      _cache.hasEnergy = _cache.hasEnergy || needE;
+      _cache.hasGradient = _cache.hasGradient || (needG && cacheGradient);
+    }
+    if (e) *e = _cache.energy;
+    if (g && _cache.hasGradient) *g = _cache.gradient; // Copies into the existing storage of g
+  }
+
+  void State::clearCache() const {
+    _cache.version = _coordsVersion;
+    _cache.hasEnergy = false;
+    _cache.hasGradient = false;
+    if (!cacheGradient) vector<double>().swap(_cache.gradient);
+  }
+
+
   // Total energy / gradient
   double State::energy() const {
     if (!usesThisProc) return 0;
-    return energy(_coords);
+    double e;
+    cachedEnergyGradient(&e, nullptr);
+    return comm->sum(e);
   }
 
   vector<double> State::gradient() const {
     if (!usesThisProc) return vector<double>();
-    return gradient(_coords);
+    vector<double> g;
+    cachedEnergyGradient(nullptr, &g);
+    if (comm->size() == 1) return g;
+    return comm->gather(g);
   }
 
   void State::energyGradient(double* e, vector<double>* g) const {
     if (!usesThisProc) return;
-    energyGradient(_coords, e, g);
+    cachedEnergyGradient(e, g);
+    if (e != nullptr) *e = comm->sum(*e);
+    if (g != nullptr && comm->size() > 1) *g = comm->gather(*g);
   }
 
   // Block energy / gradient (the gradient includes the halo, but not required to be correct)
   double State::blockEnergy() const {
     if (!usesThisProc) return 0;
-    return blockEnergy(_coords);
+    double e;
+    cachedEnergyGradient(&e, nullptr);
+    return e;
   }
 
   vector<double> State::blockGradient() const {
     if (!usesThisProc) return vector<double>();
-    return blockGradient(_coords);
+    vector<double> g;
+    cachedEnergyGradient(nullptr, &g);
+    return g;
   }
 
   void State::blockEnergyGradient(double* e, vector<double>* g) const {
     if (!usesThisProc) return;
-    blockEnergyGradient(_coords, e, g);
+    cachedEnergyGradient(e, g);
   }
 
   // Processor energy / gradient (the gradient includes the halo)
   double State::procEnergy() const {
     if (!usesThisProc) return 0;
-    return procEnergy(_coords);
+    double e;
+    cachedEnergyGradient(&e, nullptr);
+    return e;
   }
 
   vector<double> State::procGradient() const {
     if (!usesThisProc) return vector<double>();
-    return procGradient(_coords);
+    vector<double> g;
+    cachedEnergyGradient(nullptr, &g);
+    return g;
   }
 
   void State::procEnergyGradient(double* e, vector<double>* g) const {
     if (!usesThisProc) return;
-    procEnergyGradient(_coords, e, g);
+    cachedEnergyGradient(e, g);
   }
 
 
@@ -140,7 +308,8 @@ namespace minim {
     }
 
     // Parallel
-    const vector<double>& blockCoords = (coords.size() == ndof) ? comm->scatter(coords) : coords;
+    vector<double> scattered;
+    const vector<double>& blockCoords = localCoords(coords, ndof, *comm, scattered);
     if (pot->potentialType() == Potential::UNSTRUCTURED) {
       elementEG(*pot, blockCoords, &e, nullptr, *comm);
     } else {
@@ -160,12 +329,14 @@ namespace minim {
     }
 
     // Parallel
-    const vector<double>& blockCoords = (coords.size() == ndof) ? comm->scatter(coords) : coords;
+    vector<double> scattered;
+    const vector<double>& blockCoords = localCoords(coords, ndof, *comm, scattered);
     if (pot->potentialType() == Potential::UNSTRUCTURED) {
       elementEG(*pot, blockCoords, nullptr, &g, *comm);
     } else {
       basicEG(*pot, blockCoords, nullptr, &g, *comm);
     }
+    if (comm->size() == 1) return g;
     return comm->gather(g);
   }
 
@@ -179,14 +350,15 @@ namespace minim {
     }
 
     // Parallel
-    const vector<double>& blockCoords = (coords.size() == ndof) ? comm->scatter(coords) : coords;
+    vector<double> scattered;
+    const vector<double>& blockCoords = localCoords(coords, ndof, *comm, scattered);
     if (pot->potentialType() == Potential::UNSTRUCTURED) {
       elementEG(*pot, blockCoords, e, g, *comm);
     } else {
       basicEG(*pot, blockCoords, e, g, *comm);
     }
     if (e != nullptr) *e = comm->sum(*e);
-    if (g != nullptr) *g = comm->gather(*g);
+    if (g != nullptr && comm->size() > 1) *g = comm->gather(*g);
   }
 
 
@@ -248,7 +420,97 @@ namespace minim {
   void State::procEnergyGradient(const vector<double>& coords, double* e, vector<double>* g) const {
     if (!usesThisProc) return;
     blockEnergyGradient(coords, e, g);
-    comm->communicate(*g);
+    if (g) comm->communicate(*g);
+  }
+
+
+  // Batched energy / gradient of several sets of processor coordinates
+  // The energies are summed with a single reduction and the gradient halos are communicated together
+  vector<double> State::batchEnergy(const vector2d<double>& coords) const {
+    vector<double> e;
+    batchEnergyGradient(coords, &e, nullptr);
+    return e;
+  }
+
+  void State::batchEnergyGradient(const vector2d<double>& coords, vector<double>* e, vector2d<double>* g) const {
+    if (!usesThisProc) return;
+    if (e) e->resize(coords.size());
+    if (g) g->resize(coords.size());
+
+    if (pot->potentialType() == Potential::UNSTRUCTURED) {
+      batchElementEG(*pot, coords, e, g, *comm);
+    } else {
+      stats.evaluation(e, g, coords.size());
+      {
+        Stats::Timer timer(&stats, Stats::POTENTIAL);
+        pot->batchEnergyGradient(coords, *comm, e, g);
+      }
+      if (g) {
+        for (size_t k=0; k<coords.size(); k++) {
+          if (comm->size() > 1) comm->communicateAccumulate((*g)[k]); // Get correct gradient on the edges
+          Stats::Timer timer(&stats, Stats::CONSTRAINTS);
+          pot->applyConstraints(coords[k], *comm, (*g)[k]);
+        }
+      }
+    }
+
+    if (e) *e = comm->sumEach(std::move(*e));
+    if (g) comm->communicate(*g);
+  }
+
+
+  // Hessian-vector products at the state coordinates
+  vector<double> State::hessianVector(const vector<double>& v) const {
+    if (!usesThisProc) return vector<double>();
+    vector<double> scattered;
+    vector<double> hv;
+    procHessianVector(localCoords(v, ndof, *comm, scattered), &hv);
+    if (comm->size() == 1) return hv;
+    return comm->gather(hv);
+  }
+
+  void State::procHessianVector(const vector<double>& v, vector<double>* hv) const {
+    if (!usesThisProc) return;
+    stats.hessian();
+
+    if (!pot->hasHessian()) {
+      // Central difference of the gradient, with the step scaled by the size of the coordinates
+      double vNorm = comm->norm(v);
+      if (vNorm == 0) {
+        hv->assign(v.size(), 0);
+        return;
+      }
+      double eps = 1e-6 * std::max(1.0, comm->norm(_coords)) / vNorm;
+      vector<double> gMinus;
+      procEnergyGradient(_coords + eps * v, nullptr, hv);
+      procEnergyGradient(_coords - eps * v, nullptr, &gMinus);
+      for (size_t i=0; i<hv->size(); i++) (*hv)[i] = ((*hv)[i] - gMinus[i]) / (2*eps);
+      return;
+    }
+
+    {
+      Stats::Timer timer(&stats, Stats::POTENTIAL);
+      if (pot->potentialType() == Potential::UNSTRUCTURED) {
+        hv->assign(v.size(), 0);
+        for (const auto& el : pot->elements) pot->elementHessianVector(_coords, v, el, hv);
+      } else {
+        pot->hessianVector(_coords, v, *comm, hv);
+      }
+    }
+    if (comm->size() > 1) comm->communicateAccumulate(*hv); // Get the correct product on the edges
+    applyConstraints(*hv);
+    comm->communicate(*hv);
+  }
+
+  void State::procPrecondition(const vector<double>& r, vector<double>* z) const {
+    if (!usesThisProc) return;
+    if (!pot->hasPreconditioner()) {
+      *z = r;
+      return;
+    }
+    pot->precondition(_coords, r, *comm, z);
+    applyConstraints(*z);
+    comm->communicate(*z);
   }
 
 
@@ -281,8 +543,13 @@ namespace minim {
     return comm->gather(_coords, -1);
   }
 
-  void State::coords(const vector<double>& in) {
-    _coords = comm->scatter(in, -1);
+  void State::coords(vector<double> in) {
+    _coordsVersion++;
+    if (usesThisProc && comm->size() == 1) {
+      _coords = std::move(in);
+    } else {
+      _coords = comm->scatter(in, -1);
+    }
   }
 
 
@@ -290,8 +557,14 @@ namespace minim {
     return _coords;
   }
 
-  void State::blockCoords(const vector<double>& in) {
-    _coords = in;
+  void State::blockCoords(vector<double> in) {
+    _coordsVersion++;
+    _coords = std::move(in);
+  }
+
+  vector<double>& State::editBlockCoords() {
+    _coordsVersion++;
+    return _coords;
   }
 
 
@@ -304,7 +577,7 @@ namespace minim {
 
   double State::componentEnergy(int component) const {
     double e = 0;
-    for (auto el : pot->elements) {
+    for (const auto& el : pot->elements) {
       if (el.type == component) pot->elementEnergyGradient(_coords, el, &e, nullptr);
     }
     return e;
@@ -312,11 +585,13 @@ namespace minim {
 
 
   void State::communicate() {
+    _coordsVersion++;
     comm->communicate(_coords);
   }
 
 
   void State::applyConstraints(vector<double>& data) const {
+    Stats::Timer timer(&stats, Stats::CONSTRAINTS);
     pot->applyConstraints(_coords, *comm, data);
   }
 
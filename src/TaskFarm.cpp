@@ -0,0 +1,208 @@
+#include "TaskFarm.h"
+
+#include <cmath>
+#include <list>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "State.h"
+#include "Minimiser.h"
+#include "utils/mpi.h"
+
+namespace minim {
+  using std::vector;
+
+  namespace {
+    const int REQUEST_TAG = 1;
+    const int CHUNK_TAG = 2;
+    const int RESULT_TAG = 3;
+    const int HEADER = 3; // Task, energy and iterations, followed by the coordinates
+  }
+
+
+  TaskFarm::TaskFarm(int groupSize) : _groupSize(groupSize) {}
+
+
+  TaskFarm& TaskFarm::setChunk(int chunk) {
+    this->chunk = chunk;
+    return *this;
+  }
+
+  TaskFarm& TaskFarm::setGatherCoords(bool gatherCoords) {
+    this->gatherCoords = gatherCoords;
+    return *this;
+  }
+
+  TaskFarm& TaskFarm::setKeepResults(bool keepResults) {
+    this->keepResults = keepResults;
+    return *this;
+  }
+
+  TaskFarm& TaskFarm::setOnResult(Callback onResult) {
+    this->onResult = onResult;
+    return *this;
+  }
+
+
+  int TaskFarm::nGroup() const {
+    return mpi.size / _groupSize;
+  }
+
+  int TaskFarm::group() const {
+    return mpi.rank / _groupSize;
+  }
+
+  vector<int> TaskFarm::groupRanks() const {
+    if (_groupSize < 1 || mpi.size % _groupSize != 0) {
+      throw std::invalid_argument("TaskFarm: The number of processors must be a multiple of the group size.");
+    }
+    vector<int> ranks(_groupSize);
+    for (int i=0; i<_groupSize; i++) ranks[i] = group()*_groupSize + i;
+    return ranks;
+  }
+
+
+  void TaskFarm::run(State& state, const Minimiser& min, const vector<vector<double>>& inits) {
+    run(state, min, inits.size(), [&inits](int task, State& s) { s.coords(inits[task]); });
+  }
+
+
+  void TaskFarm::run(State& state, const Minimiser& min, int nTask, Setup setup) {
+    if (state.comm->ranks != groupRanks()) {
+      throw std::invalid_argument("TaskFarm: The state must be created using groupRanks().");
+    }
+    if (chunk < 1) throw std::invalid_argument("TaskFarm: The chunk size must be at least 1.");
+    this->nTask = nTask;
+    nLocal = 0;
+    _results.clear();
+    if (mpi.rank == 0 && keepResults) _results.resize(nTask);
+    std::unique_ptr<Minimiser> local = min.clone();
+    bool leader = (mpi.rank % _groupSize == 0);
+    auto start = std::chrono::steady_clock::now();
+
+    // The chunks are numbered in advance, with max(chunk, remaining / (2 nGroup)) tasks each, so that only the chunk
+    // number needs to be sent
+    vector<long> bounds = {0};
+    while (bounds.back() < nTask) {
+      long remaining = nTask - bounds.back();
+      bounds.push_back(bounds.back() + std::min(remaining, std::max((long)chunk, remaining / (2 * nGroup()))));
+    }
+    int nChunk = bounds.size() - 1;
+    int nextChunk = 0; // Rank 0 only
+
+  #ifdef PARALLEL
+    MPI_Comm comm, groupComm;
+    MPI_Comm_dup(MPI_COMM_WORLD, &comm); // Keep the messages separate from any others
+    MPI_Comm_split(comm, group(), mpi.rank, &groupComm); // Not the state communicator, which serial potentials do not use
+    std::list<std::pair<vector<double>, MPI_Request>> sends;
+    int nReceived = 0;
+    int nFinished = 0; // Groups told that there are no chunks left
+
+    // Rank 0: answer the chunk requests and receive the results that have arrived (or wait for one message)
+    auto serve = [&](bool wait) {
+      while (true) {
+        int flag = 1;
+        MPI_Status status;
+        if (wait) {
+          MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
+        } else {
+          MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &flag, &status);
+        }
+        if (!flag) return;
+        if (status.MPI_TAG == REQUEST_TAG) {
+          MPI_Recv(nullptr, 0, MPI_INT, status.MPI_SOURCE, REQUEST_TAG, comm, MPI_STATUS_IGNORE);
+          int iChunk = std::min(nextChunk++, nChunk);
+          if (iChunk == nChunk) nFinished++;
+          MPI_Send(&iChunk, 1, MPI_INT, status.MPI_SOURCE, CHUNK_TAG, comm); // The receive is already posted
+        } else {
+          int count;
+          MPI_Get_count(&status, MPI_DOUBLE, &count);
+          vector<double> buffer(count);
+          MPI_Recv(buffer.data(), count, MPI_DOUBLE, status.MPI_SOURCE, RESULT_TAG, comm, MPI_STATUS_IGNORE);
+          addResult({(int)buffer[0], buffer[1], (int)buffer[2], vector<double>(buffer.begin()+HEADER, buffer.end())});
+          nReceived++;
+        }
+        if (wait) return;
+      }
+    };
+
+    // The other group leaders always keep a request for the next chunk open, so that it arrives while they work
+    int received;
+    MPI_Request chunkRequest = MPI_REQUEST_NULL;
+    auto requestChunk = [&]() {
+      MPI_Irecv(&received, 1, MPI_INT, 0, CHUNK_TAG, comm, &chunkRequest);
+      MPI_Send(nullptr, 0, MPI_INT, 0, REQUEST_TAG, comm);
+    };
+    auto takeChunk = [&]() {
+      if (mpi.rank == 0) return std::min(nextChunk++, nChunk);
+      MPI_Wait(&chunkRequest, MPI_STATUS_IGNORE);
+      int iChunk = received;
+      if (iChunk < nChunk) requestChunk();
+      return iChunk;
+    };
+    if (leader && mpi.rank != 0) requestChunk();
+  #else
+    auto takeChunk = [&]() { return std::min(nextChunk++, nChunk); };
+  #endif
+
+    while (true) {
+      int iChunk = 0;
+      if (leader) iChunk = takeChunk();
+    #ifdef PARALLEL
+      if (_groupSize > 1) MPI_Bcast(&iChunk, 1, MPI_INT, 0, groupComm); // Share the chunk with the rest of the group
+    #endif
+      if (iChunk == nChunk) break;
+
+      for (long task=bounds[iChunk]; task<bounds[iChunk+1]; task++) {
+        setup(task, state);
+        vector<double> coords = local->minimise(state);
+        double e = local->progress.energy;
+        if (local->progress.version != state.coordsVersion() || std::isnan(e)) e = state.energy();
+        nLocal++;
+        if (!leader) continue;
+
+        Result result = {(int)task, e, local->iter, (gatherCoords) ? std::move(coords) : vector<double>()};
+      #ifdef PARALLEL
+        if (mpi.rank != 0) {
+          vector<double> buffer = {(double)task, e, (double)local->iter};
+          buffer.insert(buffer.end(), result.coords.begin(), result.coords.end());
+          sends.emplace_back(std::move(buffer), MPI_REQUEST_NULL);
+          MPI_Isend(sends.back().first.data(), sends.back().first.size(), MPI_DOUBLE, 0, RESULT_TAG, comm, &sends.back().second);
+          // Free the buffers of the sends that have completed
+          sends.remove_if([](std::pair<vector<double>, MPI_Request>& send) {
+            int done;
+            MPI_Test(&send.second, &done, MPI_STATUS_IGNORE);
+            return done;
+          });
+          continue;
+        }
+        addResult(std::move(result));
+        serve(false);
+      #else
+        addResult(std::move(result));
+      #endif
+      }
+    }
+
+  #ifdef PARALLEL
+    if (mpi.rank == 0) {
+      while (nReceived < nTask - nLocal || nFinished < nGroup() - 1) serve(true);
+    }
+    for (auto& send : sends) MPI_Wait(&send.second, MPI_STATUS_IGNORE);
+    MPI_Comm_free(&groupComm);
+    MPI_Comm_free(&comm);
+  #endif
+
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    mpi.bcast(elapsed);
+    throughput = nTask / elapsed;
+  }
+
+
+  void TaskFarm::addResult(Result result) {
+    if (onResult) onResult(result);
+    if (keepResults) _results[result.task] = std::move(result);
+  }
+
+}
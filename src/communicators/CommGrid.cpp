@@ -183,14 +183,29 @@ template <typename T>
   }
 
 
+  vector<std::pair<int,int>> CommGrid::ownedRanges() const {
+    // Merge the consecutive indices of the block
+    if (!usesThisProc) return {};
+    vector<std::pair<int,int>> ranges;
+    for (int i: RangeI(procSizes, haloWidths)) {
+      if (!ranges.empty() && ranges.back().second == i) {
+        ranges.back().second++;
+      } else {
+        ranges.push_back({i, i+1});
+      }
+    }
+    return ranges;
+  }
+
+
   //===== MPI reduction functions =====//
-  double CommGrid::dotProduct(const vector<double>& a, const vector<double>& b) const {
+  double CommGrid::localDotProduct(const vector<double>& a, const vector<double>& b) const {
     if (!usesThisProc) return 0;
     double value = 0;
     for (int i: RangeI(procSizes, haloWidths)) {
       value += a[i] * b[i];
     }
-    return sum(value);
+    return value;
   }
 
 
@@ -5,6 +5,7 @@
 #endif
 
 #include <set>
+#include <utility>
 //#include <limits>
 #include <stdexcept>
 #include "Potential.h"
@@ -102,10 +103,16 @@ namespace minim {
   }
 
 
+  vector<std::pair<int,int>> CommUnstructured::ownedRanges() const {
+    if (!usesThisProc) return {};
+    return {{0, (int)nblock}};
+  }
+
+
   //===== MPI reduction functions =====//
-  double CommUnstructured::dotProduct(const vector<double>& a, const vector<double>& b) const {
+  double CommUnstructured::localDotProduct(const vector<double>& a, const vector<double>& b) const {
     if (!usesThisProc) return 0;
-    return sum(std::inner_product(a.begin(), a.begin()+nblock, b.begin(), 0.0));
+    return std::inner_product(a.begin(), a.begin()+nblock, b.begin(), 0.0);
   }
 
 
@@ -197,7 +204,7 @@ namespace minim {
     blocks = vector2d<int>(nTot);
     in_block = vector2d<char>(nTot);
     for (int ie=0; ie<nTot; ie++) {
-      auto e_idof = (ie<nElements) ? pot.elements[ie].idof : pot.constraints[ie-nElements].idof;
+      ArrayView<const int> e_idof = (ie<nElements) ? pot.elements[ie].idof : ArrayView<const int>(pot.constraints[ie-nElements].idof);
       int e_ndof = e_idof.size();
       blocks[ie] = vector<int>(e_ndof);
       in_block[ie] = vector<char>(e_ndof);
@@ -218,7 +225,7 @@ namespace minim {
     send_lists = vector2d<int>(commSize);
     for (int ie=0; ie<nTot; ie++) {
       if (vec::all(in_block[ie]) || !vec::any(in_block[ie])) continue;
-      auto e_idof = (ie<nElements) ? pot.elements[ie].idof : pot.constraints[ie-nElements].idof;
+      ArrayView<const int> e_idof = (ie<nElements) ? pot.elements[ie].idof : ArrayView<const int>(pot.constraints[ie-nElements].idof);
       int e_ndof = e_idof.size();
       for (int i=0; i<e_ndof; i++) {
         if (in_block[ie][i]) continue;
@@ -286,13 +293,13 @@ namespace minim {
     int nElements = pot.elements.size();
     int nConstraints = pot.constraints.size();
     int nTot = nElements + nConstraints;
-    vector<Potential::Element> elements_tmp;
+    ElementTable elements_tmp;
     vector<Potential::Constraint> constraints_tmp;
 
     for (int ie=0; ie<nTot; ie++) {
       if (! vec::any(in_block[ie])) continue;
       // Update element.idof with local index
-      auto &idof = (ie<nElements) ? pot.elements[ie].idof : pot.constraints[ie-nElements].idof;
+      ArrayView<int> idof = (ie<nElements) ? pot.elements.idof(ie) : ArrayView<int>(pot.constraints[ie-nElements].idof);
       for (int i=0; i<(int)idof.size(); i++) {
         if (in_block[ie][i]) {
           idof[i] = idof[i] - iblocks[commRank];
@@ -310,13 +317,15 @@ namespace minim {
       if (ie >= nElements) {
         constraints_tmp.push_back(pot.constraints[ie-nElements]);
       } else if (el_proc[ie] == commRank) {
-        elements_tmp.push_back(pot.elements[ie]);
+        const Potential::Element& el = pot.elements[ie];
+        elements_tmp.push_back(el.type, el.idof, el.parameters);
       } else {
-        pot.elements_halo.push_back(pot.elements[ie]);
+        const Potential::Element& el = pot.elements[ie];
+        pot.elements_halo.push_back(el.type, el.idof, el.parameters);
       }
     }
     pot.constraints = constraints_tmp;
-    pot.elements = elements_tmp;
+    pot.elements = std::move(elements_tmp);
     pot.distributed = true;
   }
 
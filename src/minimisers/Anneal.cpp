@@ -1,8 +1,10 @@
 #include "minimisers/Anneal.h"
 
 #include <math.h>
-#include <time.h>
+#include <algorithm>
+#include <stdexcept>
 #include "State.h"
+#include "utils/mpi.h"
 
 namespace minim {
 
@@ -32,6 +34,17 @@ namespace minim {
     return *this;
   }
 
+  Anneal& Anneal::setSeed(unsigned seed) {
+    this->seed = seed;
+    _nStep = 0;
+    return *this;
+  }
+
+  Anneal& Anneal::setLocalMoves(bool localMoves) {
+    this->localMoves = localMoves;
+    return *this;
+  }
+
   Anneal& Anneal::setMaxRejections(int maxRejections) {
     this->maxRejections = maxRejections;
     return *this;
@@ -42,7 +55,10 @@ namespace minim {
     _sinceAccepted = 0;
     _currentState = state.blockCoords();
     _currentE = state.energy();
-    srand(time(0)+state.comm->rank()); // Set a different random seed on all processors
+    _moveRng = Philox(seed, mpi.rank, 0);
+    _acceptRng = Philox(seed, localMoves ? mpi.rank : 0, 1);
+    _stepStart = _nStep;
+    if (localMoves) initLocalMoves(state);
   }
 
 
@@ -52,19 +68,27 @@ namespace minim {
     } else {
       _temp = tempInit / (1 + coolingRate*iter);
     }
+    uint32_t step = _stepStart + iter;
+    _nStep = step + 1;
+    _moveRng.setStep(step);
+    _acceptRng.setStep(step);
+
+    if (localMoves) {
+      localIteration(state);
+      return;
+    }
 
     // Randomly perturb state
     std::vector<double> newState(state.comm->nproc);
-    for (size_t i=0; i<state.comm->nblock; i++) {
-      double random = 2 * ((double) rand() / RAND_MAX) - 1;
-      newState[i] = _currentState[i] + random*displacement;
-    }
+    _moveRng.uniform(newState.data(), state.comm->nblock, -displacement, displacement);
+    for (size_t i=0; i<state.comm->nblock; i++) newState[i] += _currentState[i];
     state.blockCoords(newState);
     state.communicate(); // Communicate to ensure halo regions are correct and not random
 
     // Accept or reject state
     double energy = state.energy();
-    if (acceptMetropolis(energy)) {
+    progress.energy = energy;
+    if (acceptMetropolis(energy-_currentE)) {
       _currentState = state.blockCoords();
       _currentE = energy;
       _sinceAccepted = 0;
@@ -73,15 +97,17 @@ namespace minim {
     }
 
     // Set final state
-    if ((checkConvergence(state)) || (iter == maxIter)) state.blockCoords(_currentState);
+    if ((checkConvergence(state)) || (iter == maxIter)) {
+      state.blockCoords(_currentState);
+      progress.energy = _currentE;
+    }
   }
 
 
-  bool Anneal::acceptMetropolis(double energy) {
-    double random = (double) rand() / RAND_MAX;
-    if (energy < _currentE) {
+  bool Anneal::acceptMetropolis(double de) {
+    if (de < 0) {
       return true;
-    } else if (random < exp((_currentE-energy)/_temp)) {
+    } else if (_acceptRng.uniform() < exp(-de/_temp)) {
       return true;
     } else {
       return false;
@@ -89,9 +115,131 @@ namespace minim {
   }
 
 
+  void Anneal::initLocalMoves(const State& state) {
+    const Potential& pot = *state.pot;
+    if (pot.potentialType() != Potential::UNSTRUCTURED) {
+      throw std::invalid_argument("Anneal: Local moves require an UNSTRUCTURED potential.");
+    }
+
+    // Build the degree of freedom to element adjacency from the local and halo elements
+    int nproc = state.comm->nproc;
+    int nLocal = pot.elements.size();
+    int nElements = nLocal + pot.elements_halo.size();
+    auto elementIdof = [&](int ie) {
+      return (ie < nLocal) ? pot.elements[ie].idof : pot.elements_halo[ie-nLocal].idof;
+    };
+    _adjStart.assign(nproc+1, 0);
+    std::vector<int> last(nproc, -1); // Skips repeated degrees of freedom within an element
+    for (int ie=0; ie<nElements; ie++) {
+      for (int i : elementIdof(ie)) {
+        if (last[i] != ie) _adjStart[i+1]++;
+        last[i] = ie;
+      }
+    }
+    for (int i=0; i<nproc; i++) _adjStart[i+1] += _adjStart[i];
+    _adjElements.resize(_adjStart[nproc]);
+    std::vector<int> next(_adjStart.begin(), _adjStart.end()-1);
+    last.assign(nproc, -1);
+    for (int ie=0; ie<nElements; ie++) {
+      for (int i : elementIdof(ie)) {
+        if (last[i] != ie) _adjElements[next[i]++] = ie;
+        last[i] = ie;
+      }
+    }
+
+    // Split the movable degrees of freedom in the block into those that only interact with the block, which can
+    // be moved by every processor at once, and those on the boundary
+    std::vector<char> constrained(nproc, false);
+    for (const auto& constraint : pot.constraints) {
+      for (int i : constraint.idof) constrained[i] = true;
+    }
+    int nblock = state.comm->nblock;
+    _interior.clear();
+    _boundary.clear();
+    for (int i=0; i<nblock; i++) {
+      if (constrained[i]) continue;
+      bool interior = true;
+      for (int j=_adjStart[i]; j<_adjStart[i+1]; j++) {
+        for (int k : elementIdof(_adjElements[j])) {
+          if (k >= nblock) interior = false;
+        }
+      }
+      (interior ? _interior : _boundary).push_back(i);
+    }
+    _currentState = state.blockCoords();
+  }
+
+
+  void Anneal::localIteration(State& state) {
+    // The interior degrees of freedom are moved on every processor, while the boundary degrees of freedom are moved
+    // by one processor per iteration. This ensures no element has degrees of freedom moved by two processors at once,
+    // so the energy changes are exact.
+    const Communicator& comm = *state.comm;
+    int nAccepted = localSweep(*state.pot, _interior);
+    if (iter % comm.size() == comm.rank()) nAccepted += localSweep(*state.pot, _boundary);
+
+    // Update the halo
+    state.blockCoords(std::move(_currentState));
+    state.communicate();
+    _currentState = state.blockCoords();
+
+    if (maxRejections > 0) {
+      if (comm.sum(nAccepted) > 0) {
+        _sinceAccepted = 0;
+      } else {
+        _sinceAccepted++;
+      }
+    }
+  }
+
+
+  int Anneal::localSweep(const Potential& pot, const std::vector<int>& dofs) {
+    // Draw the degrees of freedom to move and their displacements together
+    int nDof = dofs.size();
+    _random.resize(2*nDof);
+    _moveRng.uniform(_random);
+
+    int nAccepted = 0;
+    for (int n=0; n<nDof; n++) {
+      int i = dofs[std::min((int)(_random[2*n] * nDof), nDof-1)];
+      double eOld = dofEnergy(pot, i);
+      double coordOld = _currentState[i];
+      _currentState[i] += (2*_random[2*n+1] - 1) * displacement;
+      if (acceptMetropolis(dofEnergy(pot, i) - eOld)) {
+        nAccepted++;
+      } else {
+        _currentState[i] = coordOld;
+      }
+    }
+    return nAccepted;
+  }
+
+
+  double Anneal::dofEnergy(const Potential& pot, int i) const {
+    int nLocal = pot.elements.size();
+    double e = 0;
+    for (int j=_adjStart[i]; j<_adjStart[i+1]; j++) {
+      int ie = _adjElements[j];
+      pot.elementEnergyGradient(_currentState, (ie < nLocal) ? pot.elements[ie] : pot.elements_halo[ie-nLocal], &e, nullptr);
+    }
+    return e;
+  }
+
+
   bool Anneal::checkConvergence(const State& state) {
     bool isConverged = (maxRejections > 0) && (_sinceAccepted >= maxRejections);
     return isConverged;
   }
 
+
+  void Anneal::writeCheckpoint(Checkpoint& out) const {
+    // The random numbers only depend on the seed and step, so the chain is continued exactly
+    out.write(_stepStart).write(_sinceAccepted).write(_currentE).write(_currentState);
+  }
+
+
+  void Anneal::readCheckpoint(Checkpoint& in) {
+    in.read(_stepStart).read(_sinceAccepted).read(_currentE).read(_currentState);
+  }
+
 }
@@ -0,0 +1,270 @@
+#include "minimisers/BasinHopping.h"
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include "State.h"
+#include "utils/mpi.h"
+
+namespace minim {
+  using std::vector;
+
+
+  BasinHopping::BasinHopping(const Minimiser& local, double temperature, double displacement, int nWalker)
+    : temperature(temperature), displacement(displacement), _local(local.clone()), _nWalker((nWalker == 0) ? mpi.size : nWalker) {}
+
+  BasinHopping::BasinHopping(const BasinHopping& other)
+    : NewMinimiser<BasinHopping>(other), temperature(other.temperature), displacement(other.displacement), seed(other.seed),
+      screening(other.screening), energyTol(other.energyTol), fingerprintTol(other.fingerprintTol),
+      fingerprint(other.fingerprint), _local(other._local->clone()), _nWalker(other._nWalker), _nStep(other._nStep) {}
+
+  BasinHopping& BasinHopping::operator=(const BasinHopping& other) {
+    if (this == &other) return *this;
+    Minimiser::operator=(other);
+    temperature = other.temperature;
+    displacement = other.displacement;
+    seed = other.seed;
+    screening = other.screening;
+    energyTol = other.energyTol;
+    fingerprintTol = other.fingerprintTol;
+    fingerprint = other.fingerprint;
+    _local = other._local->clone();
+    _nWalker = other._nWalker;
+    _nStep = other._nStep;
+    return *this;
+  }
+
+
+  BasinHopping& BasinHopping::setMaxIter(int maxIter) {
+    Minimiser::setMaxIter(maxIter);
+    return *this;
+  }
+
+  BasinHopping& BasinHopping::setTemperature(double temperature) {
+    this->temperature = temperature;
+    return *this;
+  }
+
+  BasinHopping& BasinHopping::setDisplacement(double displacement) {
+    this->displacement = displacement;
+    return *this;
+  }
+
+  BasinHopping& BasinHopping::setSeed(unsigned seed) {
+    this->seed = seed;
+    _nStep = 0;
+    return *this;
+  }
+
+  BasinHopping& BasinHopping::setScreening(double screening) {
+    this->screening = screening;
+    return *this;
+  }
+
+  BasinHopping& BasinHopping::setTolerances(double energyTol, double fingerprintTol) {
+    this->energyTol = energyTol;
+    this->fingerprintTol = fingerprintTol;
+    return *this;
+  }
+
+  BasinHopping& BasinHopping::setFingerprint(Fingerprint fingerprint) {
+    this->fingerprint = fingerprint;
+    return *this;
+  }
+
+
+  BasinHopping::Fingerprint BasinHopping::particleFingerprint(int nDim) {
+    return [nDim](const vector<double>& coords) {
+      int nParticle = coords.size() / nDim;
+      vector<double> centroid(nDim, 0);
+      for (int i=0; i<nParticle; i++) {
+        for (int j=0; j<nDim; j++) centroid[j] += coords[i*nDim+j] / nParticle;
+      }
+      vector<double> dist(nParticle, 0);
+      for (int i=0; i<nParticle; i++) {
+        for (int j=0; j<nDim; j++) dist[i] += pow(coords[i*nDim+j] - centroid[j], 2);
+        dist[i] = sqrt(dist[i]);
+      }
+      std::sort(dist.begin(), dist.end());
+      return dist;
+    };
+  }
+
+
+  int BasinHopping::walker() const {
+    return mpi.rank / (mpi.size / _nWalker);
+  }
+
+  vector<int> BasinHopping::walkerRanks() const {
+    if (_nWalker < 1 || mpi.size % _nWalker != 0) {
+      throw std::invalid_argument("BasinHopping: The number of processors must be a multiple of the number of walkers.");
+    }
+    int groupSize = mpi.size / _nWalker;
+    vector<int> ranks(groupSize);
+    for (int i=0; i<groupSize; i++) ranks[i] = walker()*groupSize + i;
+    return ranks;
+  }
+
+
+  void BasinHopping::init(State& state) {
+    if (state.comm->ranks != walkerRanks()) {
+      throw std::invalid_argument("BasinHopping: The state must be created using walkerRanks().");
+    }
+    _groupSize = mpi.size / _nWalker;
+    _moveRng = Philox(seed, mpi.rank, 0);
+    _acceptRng = Philox(seed, walker(), 1);
+    _stepStart = _nStep;
+    _minima.clear();
+    _index.clear();
+    nQuench = 0;
+    nDuplicate = 0;
+
+    // Start from the minimum of the initial state
+    int iMin = quench(state);
+    _current = _minima[iMin].coords;
+    _currentE = _minima[iMin].energy;
+    _best = _current;
+    _walkerBestE = _currentE;
+    bestEnergy = _currentE;
+  }
+
+
+  void BasinHopping::iteration(State& state) {
+    // Perturb the current minimum
+    uint32_t step = _stepStart + iter;
+    _nStep = step + 1;
+    vector<double> newState(state.comm->nproc);
+    _moveRng.setStep(step).uniform(newState.data(), state.comm->nblock, -displacement, displacement);
+    for (size_t i=0; i<state.comm->nblock; i++) newState[i] += _current[i];
+    state.blockCoords(std::move(newState));
+    state.communicate(); // Communicate to ensure halo regions are correct and not random
+
+    // Minimise while the best energy of the previous iteration is shared
+    startBestReduction();
+    int iMin = quench(state);
+    finishBestReduction();
+
+    // Metropolis acceptance, with the same random number on all processors of the walker
+    const Minimum& minimum = _minima[iMin];
+    double random = _acceptRng.setStep(step).uniform();
+    if (minimum.energy < _currentE || random < exp((_currentE-minimum.energy)/temperature)) {
+      _current = minimum.coords;
+      _currentE = minimum.energy;
+      if (_currentE < _walkerBestE) {
+        _best = _current;
+        _walkerBestE = _currentE;
+        bestEnergy = std::min(bestEnergy, _walkerBestE);
+      }
+    }
+
+    // Set the final state
+    if (iter == maxIter) {
+      shareBest(state);
+      progress.energy = bestEnergy;
+    } else {
+      state.blockCoords(_current);
+      progress.energy = _currentE;
+    }
+  }
+
+
+  int BasinHopping::quench(State& state) {
+    nQuench++;
+
+    // Minimise with a looser convergence, and only finish the minimisation if it is a new minimum
+    double convergence = state.convergence;
+    state.convergence = convergence * std::max(screening, 1.0);
+    _local->minimise(state);
+    state.convergence = convergence;
+    double e = state.energy();
+    vector<double> fp = getFingerprint(state);
+    int iMin = findMinimum(e, fp);
+
+    if (iMin < 0 && screening > 1) {
+      _local->minimise(state);
+      e = state.energy();
+      fp = getFingerprint(state);
+      iMin = findMinimum(e, fp);
+    }
+
+    if (iMin >= 0) {
+      _minima[iMin].visits++;
+      nDuplicate++;
+      return iMin;
+    }
+    return addMinimum(e, std::move(fp), state.blockCoords());
+  }
+
+
+  vector<double> BasinHopping::getFingerprint(const State& state) const {
+    if (!fingerprint) return vector<double>();
+    return fingerprint(state.coords());
+  }
+
+
+  int BasinHopping::findMinimum(double energy, const vector<double>& fp) const {
+    long long bin = llround(energy / energyTol);
+    for (long long b=bin-1; b<=bin+1; b++) {
+      auto it = _index.find(b);
+      if (it == _index.end()) continue;
+      for (int iMin : it->second) {
+        const Minimum& minimum = _minima[iMin];
+        if (fabs(minimum.energy - energy) > energyTol || minimum.fingerprint.size() != fp.size()) continue;
+        bool same = true;
+        for (size_t i=0; i<fp.size(); i++) {
+          if (fabs(minimum.fingerprint[i] - fp[i]) > fingerprintTol) {
+            same = false;
+            break;
+          }
+        }
+        if (same) return iMin;
+      }
+    }
+    return -1;
+  }
+
+
+  int BasinHopping::addMinimum(double energy, vector<double> fp, const vector<double>& coords) {
+    int iMin = _minima.size();
+    _minima.push_back({energy, std::move(fp), coords});
+    _index[llround(energy / energyTol)].push_back(iMin);
+    return iMin;
+  }
+
+
+  void BasinHopping::startBestReduction() {
+#ifdef PARALLEL
+    _bestSend = {_walkerBestE, walker()};
+    MPI_Iallreduce(&_bestSend, &_bestRecv, 1, MPI_DOUBLE_INT, MPI_MINLOC, MPI_COMM_WORLD, &_bestRequest);
+#endif
+  }
+
+  void BasinHopping::finishBestReduction() {
+#ifdef PARALLEL
+    MPI_Wait(&_bestRequest, MPI_STATUS_IGNORE);
+    bestEnergy = std::min(_bestRecv.e, _walkerBestE);
+#endif
+  }
+
+
+  void BasinHopping::shareBest(State& state) {
+    // Find the walker with the lowest energy, and send its configuration to the other walkers
+#ifdef PARALLEL
+    struct { double e; int walker; } local = {_walkerBestE, walker()}, global;
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE_INT, MPI_MINLOC, MPI_COMM_WORLD);
+    bestEnergy = global.e;
+    int iBest = global.walker;
+    int iPos = mpi.rank % _groupSize;
+    if (walker() == iBest) {
+      for (int iWalker=0; iWalker<_nWalker; iWalker++) {
+        if (iWalker == iBest) continue;
+        MPI_Send(_best.data(), _best.size(), MPI_DOUBLE, iWalker*_groupSize + iPos, 0, MPI_COMM_WORLD);
+      }
+    } else {
+      MPI_Recv(_best.data(), _best.size(), MPI_DOUBLE, iBest*_groupSize + iPos, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+#endif
+    state.blockCoords(_best);
+  }
+
+}
@@ -0,0 +1,201 @@
+#include "minimisers/ConjugateGradient.h"
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "State.h"
+#include "linesearch.h"
+#include "utils/vec.h"
+
+namespace minim {
+  using std::vector;
+
+
+  ConjugateGradient::ConjugateGradient() {
+    linesearch = "wolfe";
+  }
+
+  ConjugateGradient& ConjugateGradient::setMaxIter(int maxIter) {
+    Minimiser::setMaxIter(maxIter);
+    return *this;
+  }
+
+  ConjugateGradient& ConjugateGradient::setMethod(std::string method) {
+    if (!vec::isIn({"hz","pr+"}, method)) {
+      throw std::invalid_argument("Invalid conjugate gradient method.");
+    }
+    _method = method;
+    return *this;
+  }
+
+  ConjugateGradient& ConjugateGradient::setRestart(int restart) {
+    _restart = restart;
+    return *this;
+  }
+
+  ConjugateGradient& ConjugateGradient::setMaxStep(double maxStep) {
+    _maxStep = maxStep;
+    return *this;
+  }
+
+
+  void ConjugateGradient::init(State& state) {
+    _owned = state.comm->ownedRanges();
+    _nRestart = (_restart > 0) ? _restart : state.ndof;
+  }
+
+
+  void ConjugateGradient::iteration(State& state) {
+    if (iter == 0) {
+      double e;
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_g);
+      if (precondition) {
+        state.procPrecondition(_g, &_z);
+        vector<double> dots = state.comm->sumEach({state.comm->localDotProduct(_g, _g), state.comm->localDotProduct(_g, _z)});
+        _g2 = dots[0];
+        _gz = dots[1];
+        _p = -_z;
+        _scale = 1; // The preconditioner sets the scale of the step
+      } else {
+        _g2 = state.comm->dotProduct(_g, _g);
+        _gz = _g2;
+        _p = -_g;
+        _scale = (_g2 > 0) ? _init_step / sqrt(_g2) : 1;
+      }
+      _gp = -_gz;
+    }
+
+    // Scale the direction to give the initial step
+    state.applyConstraints(_p); // The gradients are already constrained, so gp is unchanged
+    for (double& p : _p) p *= _scale;
+    double gs = _gp * _scale;
+
+    // Perform linesearch
+    double a = 1;
+    Reduction dots(*state.comm);
+    if (linesearch == "wolfe") {
+      // If pipelined, the direction dot products of each trial point are summed at the same time as its energy and slope
+      std::function<void(double)> overlap = nullptr;
+      if (pipelined) overlap = [&](double aTrial) {
+        dots.clear();
+        if (precondition) state.procPrecondition(_gNew, &_zNew);
+        directionDots(dots, aTrial);
+        dots.start();
+      };
+      a = wolfeLinesearch(state, _p, gs, _gNew, &progress.energy, overlap); // Also gives the new gradient
+    } else {
+      if (linesearch == "backtracking") {
+        a = backtrackingLinesearch(state, _p, gs, &progress.energy);
+      } else {
+        state.blockCoords(state.blockCoords() + _p);
+      }
+      // Get new gradient (and the energy if it will be needed by the next linesearch, so that it is cached)
+      double e;
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_gNew);
+    }
+
+    // _p now holds the step taken, s = alpha d
+    if (dots.size() == 0) {
+      if (precondition) state.procPrecondition(_gNew, &_zNew);
+      directionDots(dots, 1);
+      dots.start();
+    }
+    dots.wait();
+    updateDirection(dots.values(), gs*a, _scale*a);
+    std::swap(_g, _gNew);
+    std::swap(_z, _zNew);
+  }
+
+
+  void ConjugateGradient::directionDots(Reduction& sums, double a) {
+    // All dot products needed for the update are found in a single pass, to be summed with a single reduction
+    // The step taken is s = a p, and with a preconditioner z = M^-1 g, otherwise z = g
+    const double* z = (precondition) ? _z.data() : _g.data();
+    const double* zNew = (precondition) ? _zNew.data() : _gNew.data();
+    vector<double> dots(8, 0);
+    for (const auto& range : _owned) {
+      for (int j=range.first; j<range.second; j++) {
+        double gNew = _gNew[j];
+        double g = _g[j];
+        double s = a * _p[j];
+        dots[0] += gNew * gNew;
+        dots[1] += gNew * zNew[j];
+        dots[2] += gNew * z[j];
+        dots[3] += g * zNew[j];
+        dots[4] += s * gNew;
+        dots[5] += s * s;
+        dots[6] += s * zNew[j];
+        dots[7] += zNew[j] * zNew[j];
+      }
+    }
+    sums.add(dots);
+  }
+
+
+  void ConjugateGradient::updateDirection(const vector<double>& dots, double gs, double alpha) {
+    // Update the direction using the summed dot products from directionDots
+    // Only s = alpha d is stored, so the coefficients are given for s rather than d
+    const double* zNew = (precondition) ? _zNew.data() : _gNew.data();
+    double g2New = dots[0];
+    double gzNew = dots[1];
+    double yz = gzNew - dots[3]; // y.zNew
+    double yMy = gzNew - dots[2] - dots[3] + _gz; // y.M^-1 y
+    double sgNew = dots[4];
+    double s2 = dots[5];
+    progress.stepSize = sqrt(s2);
+    double szNew = dots[6];
+    double z2New = dots[7];
+    double sy = sgNew - gs;
+
+    bool restart = ((iter+1) % _nRestart == 0) || (sy <= 0);
+    double beta = 0;
+    if (!restart) {
+      if (_method == "hz") {
+        double eta = -1 / (sqrt(s2) * std::min(0.01, sqrt(_gz))); // Lower bound to ensure a descent direction
+        beta = std::max((yz - 2 * sgNew * yMy / sy) / sy, eta);
+      } else {
+        beta = std::max(0.0, yz / _gz) / alpha;
+      }
+    }
+    double gp = -gzNew + beta * sgNew;
+    if (gp >= 0) {
+      beta = 0;
+      gp = -gzNew;
+    }
+
+    // Form the new direction in place
+    for (size_t j=0; j<_p.size(); j++) _p[j] = -zNew[j] + beta * _p[j];
+
+    // Initial step from the previous change in energy (Nocedal & Wright eq. 3.60)
+    double scale = (gs < 0) ? gs / gp : _init_step / sqrt(g2New);
+    if (_maxStep != 0) {
+      double p2 = z2New - 2*beta*szNew + beta*beta*s2;
+      double stepSize = scale * sqrt(std::max(p2, 0.0));
+      if (stepSize > _maxStep) scale *= _maxStep / stepSize;
+    }
+    _g2 = g2New;
+    _gz = gzNew;
+    _gp = gp;
+    _scale = scale;
+  }
+
+
+  bool ConjugateGradient::checkConvergence(const State& state) {
+    if (state.isFailed) return true;
+    double rms = sqrt(_g2 / state.ndof);
+    progress.rmsGradient = rms;
+    return (rms < state.convergence);
+  }
+
+
+  void ConjugateGradient::writeCheckpoint(Checkpoint& out) const {
+    out.write(_g).write(_z).write(_p).write(_g2).write(_gz).write(_gp).write(_scale);
+  }
+
+
+  void ConjugateGradient::readCheckpoint(Checkpoint& in) {
+    in.read(_g).read(_z).read(_p).read(_g2).read(_gz).read(_gp).read(_scale);
+  }
+
+}
@@ -1,6 +1,8 @@
 #include "minimisers/Fire.h"
 
 #include <math.h>
+#include <algorithm>
+#include <stdexcept>
 #include "State.h"
 #include "linesearch.h"
 #include "utils/vec.h"
@@ -24,10 +26,20 @@ namespace minim {
   }
 
 
+  Fire& Fire::setMethod(std::string method) {
+    if (!vec::isIn({"fire","fire2"}, method)) {
+      throw std::invalid_argument("Invalid FIRE method.");
+    }
+    _method = method;
+    return *this;
+  }
+
+
   void Fire::init(State& state) {
     _v = std::vector<double>(state.comm->nproc);
+    _owned = state.comm->ownedRanges();
     if (dtMax != 0) return;
-    _g = state.procGradient();
+    state.procEnergyGradient(nullptr, &_g);
     _gNorm = sqrt(state.comm->dotProduct(_g, _g));
     if (_gNorm!=0) {
       dtMax = 0.1 / sqrt(_gNorm);
@@ -39,16 +51,21 @@ namespace minim {
 
 
   void Fire::iteration(State& state) {
+    if (_method == "fire2") {
+      iterationFire2(state);
+      return;
+    }
+
     if (iter == 0) {
       _dt = dtMax;
-      _g = state.procGradient();
-      _gNorm = sqrt(state.comm->dotProduct(_g, _g));
+      state.procEnergyGradient(nullptr, &_g);
+      updateDots(state);
     }
-    double p = - state.comm->dotProduct(_v, _g);
+    double p = -_vg;
 
     // Update velocity
     if (p > 0) {
-      double vNorm = sqrt(state.comm->dotProduct(_v, _v));
+      double vNorm = sqrt(_vv);
       _v = (1-_a)*_v - (_a*vNorm/_gNorm + _dt)*_g;
       _nSteps++;
     } else {
@@ -71,22 +88,111 @@ namespace minim {
     state.applyConstraints(step);
 
     // Perform linesearch (if set)
-    if (linesearch == "backtracking") {
+    if (linesearch == "wolfe") {
       double gs = state.comm->dotProduct(_g, step);
-      backtrackingLinesearch(state, step, gs);
+      wolfeLinesearch(state, step, gs, _g, &progress.energy); // Also gives the new gradient
     } else {
-      state.blockCoords(state.blockCoords() + step);
+      if (linesearch == "backtracking") {
+        double gs = state.comm->dotProduct(_g, step);
+        backtrackingLinesearch(state, step, gs, &progress.energy);
+      } else {
+        state.blockCoords(state.blockCoords() + step);
+      }
+      // Update gradient (and the energy if it will be needed by the next linesearch, so that it is cached)
+      double e;
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_g);
+    }
+    updateDots(state);
+  }
+
+
+  void Fire::iterationFire2(State& state) {
+    // FIRE 2.0 (Guenole et al. 2020), with the force F = -g
+    if (iter == 0) {
+      _dt = dtMax;
+      _a = _aStart2;
+      _nSteps = 0;
+      state.procEnergyGradient(nullptr, &_g);
+      updateDots(state);
     }
+    double p = -_vg;
 
-    // Update gradient
-    _g = state.procGradient();
-    _gNorm = sqrt(state.comm->dotProduct(_g, _g));
+    // Adjust time step, and on an uphill step move back half a step and stop
+    bool stop = (p <= 0);
+    if (!stop) {
+      _nSteps++;
+      if (_nSteps > _nDelay) {
+        _dt = std::min(_dt * _fInc, dtMax);
+        _a = _a * _fA;
+      }
+    } else {
+      _nSteps = 0;
+      if (iter >= _nDelay && _dt * _fDec >= _dtMinRatio * dtMax) {
+        _dt = _dt * _fDec;
+        _a = _aStart2;
+      }
+    }
+
+    // Semi-implicit Euler step, v += dt F, mixed as v = (1-a) v + a |v| F / |F|, and x += dt v
+    // The norm of the updated velocity is found from the dot products of the previous step, so the velocity and
+    // coordinates are updated in place in a single pass
+    double vv = (stop) ? 0 : _vv;
+    double vg = (stop) ? 0 : _vg;
+    double g2 = _gNorm * _gNorm;
+    double vNorm = sqrt(std::max(vv - 2*_dt*vg + _dt*_dt*g2, 0.0));
+    double mix = (_gNorm > 0) ? _a * vNorm / _gNorm : 0;
+    double back = (stop) ? 0.5*_dt : 0;
+    double vScale = (stop) ? 0 : 1-_a;
+    double gScale = (1-_a)*_dt + mix;
+
+    std::vector<double>& coords = state.editBlockCoords();
+    for (size_t i=0; i<coords.size(); i++) {
+      coords[i] -= back * _v[i];
+      _v[i] = vScale * _v[i] - gScale * _g[i];
+      coords[i] += _dt * _v[i];
+    }
+
+    state.procEnergyGradient(nullptr, &_g);
+    state.applyConstraints(_v); // Keep the velocity in the same space as the constrained gradient
+    updateDots(state);
+  }
+
+
+  void Fire::updateDots(const State& state) {
+    // All of the dot products for the next step with a single reduction
+    double vv = 0, vg = 0, gg = 0;
+    for (const auto& range : _owned) {
+      for (int i=range.first; i<range.second; i++) {
+        vv += _v[i] * _v[i];
+        vg += _v[i] * _g[i];
+        gg += _g[i] * _g[i];
+      }
+    }
+    Reduction dots(*state.comm);
+    int iVv = dots.add(vv);
+    int iVg = dots.add(vg);
+    int iGg = dots.add(gg);
+    dots.reduce();
+    _vv = dots[iVv];
+    _vg = dots[iVg];
+    _gNorm = sqrt(dots[iGg]);
   }
 
 
   bool Fire::checkConvergence(const State& state) {
     double rms = _gNorm / sqrt(state.ndof);
+    progress.rmsGradient = rms;
     return (rms < state.convergence);
   }
 
+
+  void Fire::writeCheckpoint(Checkpoint& out) const {
+    out.write(dtMax).write(_dt).write(_a).write(_nSteps).write(_v).write(_g).write(_gNorm).write(_vv).write(_vg);
+  }
+
+
+  void Fire::readCheckpoint(Checkpoint& in) {
+    in.read(dtMax).read(_dt).read(_a).read(_nSteps).read(_v).read(_g).read(_gNorm).read(_vv).read(_vg);
+  }
+
 }
@@ -21,28 +21,56 @@ namespace minim {
 
   void GradDescent::init(State& state) {
     _g = std::vector<double>(state.ndof);
+    _gVersion = 0;
   }
 
 
   void GradDescent::iteration(State& state) {
-    // Get step
-    _g = state.procGradient();
-    auto step = -_alpha * _g;
+    // Get step (the energy is evaluated together with the gradient if it will be needed by the linesearch)
+    // The Wolfe linesearch gives the gradient at the accepted point, which is reused if the coordinates are unchanged
+    if (iter == 0 || _gVersion != state.coordsVersion()) {
+      double e;
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_g);
+    }
+    std::vector<double> step;
+    if (precondition) {
+      state.procPrecondition(_g, &step);
+      step *= -_alpha;
+    } else {
+      step = -_alpha * _g;
+    }
+
+    // The gradient norm for the convergence check and the slope for the linesearch with a single reduction
+    Reduction dots(*state.comm);
+    int iG2 = dots.addDot(_g, _g);
+    int iGs = (linesearch != "none") ? dots.addDot(_g, step) : -1;
 
     // Perform linesearch
     if (linesearch == "backtracking") {
-      double gs = state.comm->dotProduct(_g, step);
-      backtrackingLinesearch(state, step, gs);
+      dots.reduce();
+      backtrackingLinesearch(state, step, dots[iGs], &progress.energy);
+    } else if (linesearch == "wolfe") {
+      dots.reduce();
+      wolfeLinesearch(state, step, dots[iGs], _g, &progress.energy);
+      _gVersion = state.coordsVersion();
     } else {
+      dots.start(); // Overlap the reduction with the update
       state.blockCoords(state.blockCoords() + step); // The step is correct on the halo, so no need to communicate the coords
+      dots.wait();
     }
+    _g2 = dots[iG2];
   }
 
 
   bool GradDescent::checkConvergence(const State& state) {
-    double sum = state.comm->dotProduct(_g, _g);
-    double rms = sqrt(sum/state.ndof);
+    double rms = sqrt(_g2/state.ndof);
     return (rms < state.convergence);
   }
 
+
+  void GradDescent::writeCheckpoint(Checkpoint& out) const {} // Each iteration only depends on the coordinates
+
+
+  void GradDescent::readCheckpoint(Checkpoint& in) {}
+
 }
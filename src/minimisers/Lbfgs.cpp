@@ -1,6 +1,8 @@
 #include "minimisers/Lbfgs.h"
 
 #include <math.h>
+#include <utility>
+#include <stdexcept>
 #include "State.h"
 #include "linesearch.h"
 #include "utils/vec.h"
@@ -27,102 +29,323 @@ namespace minim {
 
 
   void Lbfgs::init(State& state) {
-    _s = vector2d<double>(_m);
-    _y = vector2d<double>(_m);
-    _rho = vector<double>(_m);
+    size_t n = state.blockCoords().size();
+    _nSlot = _m + 1;
+    _stride = (n + 7) / 8 * 8; // Keep each row aligned to a cache line
+    _history.assign(2 * _nSlot * _stride, 0);
+    _owned = state.comm->ownedRanges();
+    _rho = vector<double>(_nSlot);
+    _gram = vector<double>((2*_nSlot+1)*(2*_nSlot+1), 0);
+    _delta = vector<double>(2*_nSlot+1);
   }
 
 
   void Lbfgs::iteration(State& state) {
     if (iter == 0) {
-      _g = state.procGradient();
+      double e;
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_g);
+      setGram(iG(), iG(), state.comm->dotProduct(_g, _g));
       _i = 0;
     } else {
       _i++;
     }
 
     // Find minimisation direction
-    vector<double> step = getDirection(*state.comm);
-    state.applyConstraints(step);
+    double gs;
+    getDirection(state, &gs);
+    state.applyConstraints(_step); // The basis vectors are already constrained, so gs is unchanged
     // Ensure it is going downhill
-    double gs = state.comm->dotProduct(_g, step);
     if (gs > 0) {
       gs = -gs;
-      step = -step;
+      for (double& s : _step) s = -s;
     }
 
     // Perform linesearch
-    if (linesearch == "backtracking") {
-      backtrackingLinesearch(state, step, gs);
+    Reduction history(*state.comm);
+    if (linesearch == "wolfe") {
+      // If pipelined, the history dot products of each trial point are summed at the same time as its energy and slope
+      std::function<void(double)> overlap = nullptr;
+      if (pipelined) overlap = [&](double a) {
+        history.clear();
+        historyDots(history, a);
+        history.start();
+      };
+      wolfeLinesearch(state, _step, gs, _gNew, &progress.energy, overlap); // Also gives the new gradient
     } else {
-      state.blockCoords(state.blockCoords() + step);
+      if (linesearch == "backtracking") {
+        backtrackingLinesearch(state, _step, gs, &progress.energy);
+      } else {
+        state.blockCoords(state.blockCoords() + _step);
+      }
+      // Get new gradient (and the energy if it will be needed by the next linesearch, so that it is cached)
+      double e;
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_gNew);
     }
 
-    // Get new gradient
-    vector<double> gNew = state.procGradient();
-
     // Store the changes required for LBFGS
-    double sy = state.comm->dotProduct(step, gNew-_g);
-    if (sy != 0) {
-      int i_cycle = _i % _m;
-      _s[i_cycle] = step;
-      _y[i_cycle] = gNew - _g;
-      _rho[i_cycle] = 1 / sy;
-    } else {
-      _i --;
+    if (history.size() == 0) {
+      historyDots(history, 1);
+      history.start();
     }
+    history.wait();
+    updateHistory(history.values());
 
-    _g = gNew;
+    std::swap(_g, _gNew); // Keep both buffers to avoid reallocating the gradient
   }
 
 
-  vector<double> Lbfgs::getDirection(const Communicator& comm) {
-    vector<double> alpha(_m);
+  void Lbfgs::getDirection(const State& state, double* gs) {
+    // Two-loop recursion on the coefficients of the basis vectors (VL-BFGS), evaluated redundantly on each processor
     int m_tmp = std::min(_m, _i);
-    int i_cycle = _i % _m;
+    int i_cycle = _i % _nSlot;
+    int nBasis = 2*_nSlot + 1;
+    vector<double> alpha(_nSlot);
 
-    vector<double> step = -_g;
+    std::fill(_delta.begin(), _delta.end(), 0);
+    _delta[iG()] = -1;
 
-    if (_i == 0) {
+    if (_i == 0 && !precondition) {
       // First iteration: Directly set the step size
-      double gnorm = comm.norm(_g);
-      if (gnorm > 0) step *= _init_step / gnorm;
-      return step;
+      double gnorm = sqrt(gram(iG(), iG()));
+      if (gnorm > 0) _delta[iG()] *= _init_step / gnorm;
+
+    } else {
+      for (int i1=0; i1<m_tmp; i1++) {
+        int i = (i_cycle - 1 - i1 + _nSlot) % _nSlot;
+        double dots = 0;
+        for (int l=0; l<nBasis; l++) dots += _delta[l] * gram(l, iS(i));
+        alpha[i] = _rho[i] * dots;
+        _delta[iY(i)] -= alpha[i];
+      }
+
+      if (precondition) {
+        preconditionDirection(state, alpha, gs);
+        return;
+      }
+
+      int i = (i_cycle - 1 + _nSlot) % _nSlot;
+      double gamma = 1 / (_rho[i] * gram(iY(i), iY(i)));
+      for (double& d : _delta) d *= gamma;
+
+      for (int i1=0; i1<m_tmp; i1++) {
+        int i = (i_cycle - m_tmp + i1 + _nSlot) % _nSlot;
+        double dots = 0;
+        for (int l=0; l<nBasis; l++) dots += _delta[l] * gram(l, iY(i));
+        double beta = _rho[i] * dots;
+        _delta[iS(i)] += alpha[i] - beta;
+      }
+
+      // Cap the max step size (if using)
+      if (_maxStep != 0) {
+        double stepSize2 = 0;
+        for (int l=0; l<nBasis; l++) {
+          for (int k=0; k<nBasis; k++) stepSize2 += _delta[l] * _delta[k] * gram(l, k);
+        }
+        double stepSize = sqrt(std::max(stepSize2, 0.0));
+        if (stepSize > _maxStep) for (double& d : _delta) d *= _maxStep / stepSize;
+      }
     }
 
-    int ndof = step.size();
+    *gs = 0;
+    for (int l=0; l<nBasis; l++) *gs += _delta[l] * gram(l, iG());
+    formStep();
+  }
+
+
+  void Lbfgs::formStep() {
+    // Form the combination of the basis vectors given by _delta in place
+    int m_tmp = std::min(_m, _i);
+    int i_cycle = _i % _nSlot;
+    size_t n = _g.size();
+    _step.resize(n);
+    for (size_t j=0; j<n; j++) _step[j] = _delta[iG()] * _g[j];
     for (int i1=0; i1<m_tmp; i1++) {
-      int i = (i_cycle - 1 - i1 + _m) % _m;
-      alpha[i] = _rho[i] * comm.dotProduct(step, _s[i]);
-      for (int j=0; j<ndof; j++) {
-        step[j] -= alpha[i] * _y[i][j];
-      }
+      int i = (i_cycle - 1 - i1 + _nSlot) % _nSlot;
+      const double* s = sRow(i);
+      const double* y = yRow(i);
+      double dS = _delta[iS(i)];
+      double dY = _delta[iY(i)];
+      for (size_t j=0; j<n; j++) _step[j] += dS * s[j] + dY * y[j];
     }
+  }
+
 
-    int i = (i_cycle - 1 + _m) % _m;
-    double gamma = 1 / (_rho[i] * comm.dotProduct(_y[i], _y[i]));
-    step *= gamma;
+  void Lbfgs::preconditionDirection(const State& state, const vector<double>& alpha, double* gs) {
+    // The preconditioner is used as the initial inverse Hessian, so q from the first loop is formed and z = M^-1 q
+    // The step is then z + sum_i eps_i s_i, with the dot products of z needed by the second loop found using one reduction
+    int m_tmp = std::min(_m, _i);
+    int i_cycle = _i % _nSlot;
+    formStep();
+    state.procPrecondition(_step, &_z);
+
+    vector<double> dots(2*_nSlot+2, 0); // z.s_i, z.y_i, z.g, z.z
+    for (int i1=0; i1<m_tmp; i1++) {
+      int i = (i_cycle - 1 - i1 + _nSlot) % _nSlot;
+      const double* s = sRow(i);
+      const double* y = yRow(i);
+      for (const auto& range : _owned) {
+        for (int j=range.first; j<range.second; j++) {
+          dots[iS(i)] += _z[j] * s[j];
+          dots[iY(i)] += _z[j] * y[j];
+        }
+      }
+    }
+    for (const auto& range : _owned) {
+      for (int j=range.first; j<range.second; j++) {
+        dots[iG()] += _z[j] * _g[j];
+        dots[iG()+1] += _z[j] * _z[j];
+      }
+    }
+    dots = state.comm->sumEach(std::move(dots));
 
+    vector<double> eps(_nSlot, 0);
     for (int i1=0; i1<m_tmp; i1++) {
-      int i = (i_cycle - m_tmp + i1 + _m) % _m;
-      double beta = _rho[i] * comm.dotProduct(step, _y[i]);
-      step += (alpha[i]-beta) * _s[i];
+      int i = (i_cycle - m_tmp + i1 + _nSlot) % _nSlot;
+      double yr = dots[iY(i)];
+      for (int k=0; k<_nSlot; k++) yr += eps[k] * gram(iY(i), iS(k));
+      eps[i] += alpha[i] - _rho[i] * yr;
     }
 
+    *gs = dots[iG()];
+    for (int k=0; k<_nSlot; k++) *gs += eps[k] * gram(iG(), iS(k));
+
     // Cap the max step size (if using)
+    double factor = 1;
     if (_maxStep != 0) {
-      double stepSize = comm.norm(step);
-      if (stepSize > _maxStep) step *= _maxStep / stepSize;
+      double stepSize2 = dots[iG()+1];
+      for (int k=0; k<_nSlot; k++) {
+        stepSize2 += 2 * eps[k] * dots[iS(k)];
+        for (int l=0; l<_nSlot; l++) stepSize2 += eps[k] * eps[l] * gram(iS(k), iS(l));
+      }
+      double stepSize = sqrt(std::max(stepSize2, 0.0));
+      if (stepSize > _maxStep) factor = _maxStep / stepSize;
     }
+    *gs *= factor;
 
-    return step;
+    size_t n = _g.size();
+    for (size_t j=0; j<n; j++) _step[j] = factor * _z[j];
+    for (int i1=0; i1<m_tmp; i1++) {
+      int i = (i_cycle - 1 - i1 + _nSlot) % _nSlot;
+      const double* s = sRow(i);
+      double dS = factor * eps[i];
+      for (size_t j=0; j<n; j++) _step[j] += dS * s[j];
+    }
+  }
+
+
+  void Lbfgs::historyDots(Reduction& sums, double a) {
+    // In a single pass: form s = a step and y = gNew - g, write them into the free slot, and compute the dot products
+    // of the new vectors (s, y, gNew) with the previous pairs and each other. These are then summed using one reduction.
+    int nPrev = std::min(_m, _i);
+    int i_cycle = _i % _nSlot;
+    vector<const double*> basis(2*nPrev);
+    for (int k=0; k<nPrev; k++) {
+      int i = (i_cycle - 1 - k + _nSlot) % _nSlot;
+      basis[k] = sRow(i);
+      basis[nPrev+k] = yRow(i);
+    }
+    int nBasis = 2*nPrev + 3; // Previous s, previous y, new s, new y, new g
+    int iNewS = 2*nPrev, iNewY = 2*nPrev+1, iNewG = 2*nPrev+2;
+    vector<double> dots(3*nBasis, 0);
+    double* sNew = sRow(i_cycle);
+    double* yNew = yRow(i_cycle);
+    double* dotS = &dots[0];
+    double* dotY = &dots[nBasis];
+    double* dotG = &dots[2*nBasis];
+
+    size_t n = _g.size();
+    size_t j = 0;
+    auto write = [&](size_t jEnd) {
+      for (; j<jEnd; j++) {
+        sNew[j] = a * _step[j];
+        yNew[j] = _gNew[j] - _g[j];
+      }
+    };
+    for (const auto& range : _owned) {
+      write(range.first); // Halo
+      for (; j<(size_t)range.second; j++) {
+        double s = a * _step[j];
+        double y = _gNew[j] - _g[j];
+        double g = _gNew[j];
+        sNew[j] = s;
+        yNew[j] = y;
+        for (int b=0; b<2*nPrev; b++) {
+          double x = basis[b][j];
+          dotS[b] += s * x;
+          dotY[b] += y * x;
+          dotG[b] += g * x;
+        }
+        dotS[iNewS] += s * s;
+        dotS[iNewY] += s * y;
+        dotS[iNewG] += s * g;
+        dotY[iNewY] += y * y;
+        dotY[iNewG] += y * g;
+        dotG[iNewG] += g * g;
+      }
+    }
+    write(n);
+    sums.add(dots);
+  }
+
+
+  void Lbfgs::updateHistory(const vector<double>& dots) {
+    // Update the Gram matrix with the summed dot products from historyDots
+    int nPrev = std::min(_m, _i);
+    int i_cycle = _i % _nSlot;
+    int nBasis = 2*nPrev + 3;
+    int iNewS = 2*nPrev, iNewY = 2*nPrev+1, iNewG = 2*nPrev+2;
+    const double* dotS = &dots[0];
+    const double* dotY = &dots[nBasis];
+    const double* dotG = &dots[2*nBasis];
+    progress.stepSize = sqrt(dotS[iNewS]);
+
+    double sy = dotS[iNewY];
+    if (sy != 0) {
+      for (int k=0; k<nPrev; k++) {
+        int i = (i_cycle - 1 - k + _nSlot) % _nSlot;
+        setGram(iS(i_cycle), iS(i), dotS[k]);
+        setGram(iS(i_cycle), iY(i), dotS[nPrev+k]);
+        setGram(iY(i_cycle), iS(i), dotY[k]);
+        setGram(iY(i_cycle), iY(i), dotY[nPrev+k]);
+      }
+      setGram(iS(i_cycle), iS(i_cycle), dotS[iNewS]);
+      setGram(iS(i_cycle), iY(i_cycle), sy);
+      setGram(iY(i_cycle), iY(i_cycle), dotY[iNewY]);
+      setGram(iS(i_cycle), iG(), dotS[iNewG]);
+      setGram(iY(i_cycle), iG(), dotY[iNewG]);
+      _rho[i_cycle] = 1 / sy;
+    } else {
+      _i --; // The slot is left free
+    }
+    for (int k=0; k<nPrev; k++) {
+      int i = (i_cycle - 1 - k + _nSlot) % _nSlot;
+      setGram(iS(i), iG(), dotG[k]);
+      setGram(iY(i), iG(), dotG[nPrev+k]);
+    }
+    setGram(iG(), iG(), dotG[iNewG]);
   }
 
 
   bool Lbfgs::checkConvergence(const State& state) {
     if (state.isFailed) return true;
-    double rms = sqrt(state.comm->dotProduct(_g, _g) / state.ndof);
+    double rms = sqrt(gram(iG(), iG()) / state.ndof); // The gradient norm is stored in the Gram matrix
+    progress.rmsGradient = rms;
     return (rms < state.convergence);
   }
 
+
+  void Lbfgs::writeCheckpoint(Checkpoint& out) const {
+    out.write(_i).write(_g).write(_rho).write(_gram).write(_history);
+  }
+
+
+  void Lbfgs::readCheckpoint(Checkpoint& in) {
+    size_t nGram = _gram.size();
+    size_t nHistory = _history.size();
+    in.read(_i).read(_g).read(_rho).read(_gram).read(_history);
+    if (_gram.size() != nGram || _history.size() != nHistory) {
+      throw std::invalid_argument("Lbfgs: The checkpoint was written with a different history length.");
+    }
+  }
+
 }
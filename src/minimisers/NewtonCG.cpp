@@ -0,0 +1,185 @@
+#include "minimisers/NewtonCG.h"
+
+#include <math.h>
+#include <algorithm>
+#include "State.h"
+#include "linesearch.h"
+#include "utils/vec.h"
+
+namespace minim {
+  using std::vector;
+
+
+  NewtonCG& NewtonCG::setMaxIter(int maxIter) {
+    Minimiser::setMaxIter(maxIter);
+    return *this;
+  }
+
+  NewtonCG& NewtonCG::setMaxCGIter(int maxCGIter) {
+    _maxCGIter = maxCGIter;
+    return *this;
+  }
+
+  NewtonCG& NewtonCG::setMaxStep(double maxStep) {
+    _maxStep = maxStep;
+    return *this;
+  }
+
+
+  void NewtonCG::iteration(State& state) {
+    double e;
+    if (iter == 0) {
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_g);
+      _g2 = state.comm->dotProduct(_g, _g);
+    }
+
+    vector<double> step = (pipelined) ? getDirectionPipelined(state) : getDirection(state);
+    state.applyConstraints(step);
+
+    // Get the slope and the step size with a single reduction
+    Reduction dots(*state.comm);
+    int iGs = dots.addDot(_g, step);
+    int iS2 = (_maxStep != 0) ? dots.addDot(step, step) : -1;
+    dots.reduce();
+    double gs = dots[iGs];
+
+    // Cap the max step size (if using)
+    if (_maxStep != 0) {
+      double stepSize = sqrt(dots[iS2]);
+      if (stepSize > _maxStep) {
+        step *= _maxStep / stepSize;
+        gs *= _maxStep / stepSize;
+      }
+    }
+
+    // Ensure it is going downhill
+    if (gs > 0) {
+      gs = -gs;
+      step = -step;
+    }
+
+    // Perform linesearch, starting from the full Newton step
+    if (linesearch == "wolfe") {
+      wolfeLinesearch(state, step, gs, _g, &progress.energy); // Also gives the new gradient
+    } else {
+      if (linesearch == "backtracking") {
+        backtrackingLinesearch(state, step, gs, &progress.energy);
+      } else {
+        state.blockCoords(state.blockCoords() + step);
+      }
+      // Get the new gradient (and the energy if it will be needed by the next linesearch, so that it is cached)
+      state.procEnergyGradient((linesearch!="none") ? &e : nullptr, &_g);
+    }
+    _g2 = state.comm->dotProduct(_g, _g); // Used by the convergence check and the next direction
+  }
+
+
+  vector<double> NewtonCG::getDirection(State& state) {
+    // Conjugate gradient solve of H p = -g, using the forcing term min(0.5, sqrt|g|) |g|
+    const Communicator& comm = *state.comm;
+    double r2 = _g2;
+    double gNorm = sqrt(r2);
+    double tol = std::min(0.5, sqrt(gNorm)) * gNorm;
+    int maxCGIter = (_maxCGIter > 0) ? _maxCGIter : state.ndof;
+
+    vector<double> p(_g.size(), 0);
+    _r = _g;
+    _d = -_g;
+    for (int j=0; j<maxCGIter; j++) {
+      state.procHessianVector(_d, &_hd);
+      double dHd = comm.dotProduct(_d, _hd);
+      if (dHd <= 0) {
+        // Negative curvature: use the current solution, or steepest descent on the first iteration
+        if (j == 0) p = -_g;
+        break;
+      }
+
+      double alpha = r2 / dHd;
+      for (size_t i=0; i<p.size(); i++) {
+        p[i] += alpha * _d[i];
+        _r[i] += alpha * _hd[i];
+      }
+      double r2New = comm.dotProduct(_r, _r);
+      if (sqrt(r2New) < tol) break;
+
+      double beta = r2New / r2;
+      for (size_t i=0; i<_d.size(); i++) {
+        _d[i] = -_r[i] + beta * _d[i];
+      }
+      r2 = r2New;
+    }
+
+    return p;
+  }
+
+
+  vector<double> NewtonCG::getDirectionPipelined(State& state) {
+    // Pipelined conjugate gradient solve of H p = -g (Ghysels & Vanroose 2014), with the same forcing term
+    // The recurrences for w = H r and z = H s mean that the single reduction of each iteration overlaps the
+    // Hessian-vector product, at the cost of one extra product at the start
+    const Communicator& comm = *state.comm;
+    double gNorm = sqrt(_g2);
+    double tol = std::min(0.5, sqrt(gNorm)) * gNorm;
+    int maxCGIter = (_maxCGIter > 0) ? _maxCGIter : state.ndof;
+
+    vector<double> p(_g.size(), 0);
+    _r = -_g;
+    state.procHessianVector(_r, &_w);
+    _d.assign(_g.size(), 0);
+    _s.assign(_g.size(), 0);
+    _z.assign(_g.size(), 0);
+    double r2Old = 0;
+    double alphaOld = 0;
+    for (int j=0; j<maxCGIter; j++) {
+      Reduction dots(comm);
+      int iR2 = dots.addDot(_r, _r);
+      int iWr = dots.addDot(_w, _r);
+      dots.start();
+      state.procHessianVector(_w, &_hd); // q = H w
+      dots.wait();
+
+      double r2 = dots[iR2];
+      if (j > 0 && sqrt(r2) < tol) break;
+      double beta = (j > 0) ? r2 / r2Old : 0;
+      double dHd = (j > 0) ? dots[iWr] - beta * r2 / alphaOld : dots[iWr];
+      if (dHd <= 0) {
+        // Negative curvature: use the current solution, or steepest descent on the first iteration
+        if (j == 0) p = -_g;
+        break;
+      }
+
+      double alpha = r2 / dHd;
+      for (size_t i=0; i<p.size(); i++) {
+        _z[i] = _hd[i] + beta * _z[i];
+        _s[i] = _w[i] + beta * _s[i];
+        _d[i] = _r[i] + beta * _d[i];
+        p[i] += alpha * _d[i];
+        _r[i] -= alpha * _s[i];
+        _w[i] -= alpha * _z[i];
+      }
+      r2Old = r2;
+      alphaOld = alpha;
+    }
+
+    return p;
+  }
+
+
+  bool NewtonCG::checkConvergence(const State& state) {
+    if (state.isFailed) return true;
+    double rms = sqrt(_g2 / state.ndof);
+    progress.rmsGradient = rms;
+    return (rms < state.convergence);
+  }
+
+
+  void NewtonCG::writeCheckpoint(Checkpoint& out) const {
+    out.write(_g).write(_g2);
+  }
+
+
+  void NewtonCG::readCheckpoint(Checkpoint& in) {
+    in.read(_g).read(_g2);
+  }
+
+}
@@ -0,0 +1,170 @@
+#include "minimisers/ParallelTempering.h"
+
+#include <math.h>
+#include <stdexcept>
+#include "State.h"
+#include "utils/mpi.h"
+
+namespace minim {
+  using std::vector;
+
+
+  ParallelTempering::ParallelTempering(double tempMin, double tempMax, double displacement, int nReplica)
+    : displacement(displacement)
+  {
+    if (nReplica == 0) nReplica = mpi.size;
+    temperatures = vector<double>(nReplica, tempMin);
+    for (int i=1; i<nReplica; i++) temperatures[i] = tempMin * pow(tempMax/tempMin, (double)i/(nReplica-1));
+  }
+
+
+  ParallelTempering& ParallelTempering::setMaxIter(int maxIter) {
+    Minimiser::setMaxIter(maxIter);
+    return *this;
+  }
+
+  ParallelTempering& ParallelTempering::setDisplacement(double displacement) {
+    this->displacement = displacement;
+    return *this;
+  }
+
+  ParallelTempering& ParallelTempering::setTemperatures(vector<double> temperatures) {
+    this->temperatures = temperatures;
+    return *this;
+  }
+
+  ParallelTempering& ParallelTempering::setExchangeInterval(int exchangeInterval) {
+    this->exchangeInterval = exchangeInterval;
+    return *this;
+  }
+
+  ParallelTempering& ParallelTempering::setSeed(unsigned seed) {
+    this->seed = seed;
+    _nStep = 0;
+    return *this;
+  }
+
+
+  int ParallelTempering::replica() const {
+    return mpi.rank / (mpi.size / nReplica());
+  }
+
+  vector<int> ParallelTempering::replicaRanks() const {
+    if (nReplica() < 1 || mpi.size % nReplica() != 0) {
+      throw std::invalid_argument("ParallelTempering: The number of processors must be a multiple of the number of replicas.");
+    }
+    int groupSize = mpi.size / nReplica();
+    vector<int> ranks(groupSize);
+    for (int i=0; i<groupSize; i++) ranks[i] = replica()*groupSize + i;
+    return ranks;
+  }
+
+
+  void ParallelTempering::init(State& state) {
+    if (state.comm->ranks != replicaRanks()) {
+      throw std::invalid_argument("ParallelTempering: The state must be created using replicaRanks().");
+    }
+    _groupSize = mpi.size / nReplica();
+    _current = state.blockCoords();
+    _currentE = state.energy();
+    _best = _current;
+    bestEnergy = _currentE;
+    nExchange = 0;
+    nExchangeAttempt = 0;
+    _moveRng = Philox(seed, mpi.rank, 0);
+    _acceptRng = Philox(seed, replica(), 1);
+    _exchangeRng = Philox(seed, 0, 2);
+    _stepStart = _nStep;
+  }
+
+
+  void ParallelTempering::iteration(State& state) {
+    double temp = temperatures[replica()];
+    uint32_t step = _stepStart + iter;
+    _nStep = step + 1;
+
+    // Randomly perturb the state
+    vector<double> newState(state.comm->nproc);
+    _moveRng.setStep(step).uniform(newState.data(), state.comm->nblock, -displacement, displacement);
+    for (size_t i=0; i<state.comm->nblock; i++) newState[i] += _current[i];
+    state.blockCoords(std::move(newState));
+    state.communicate(); // Communicate to ensure halo regions are correct and not random
+
+    // Metropolis acceptance, with the same random number on all processors of the replica
+    double energy = state.energy();
+    double random = _acceptRng.setStep(step).uniform();
+    if (energy < _currentE || random < exp((_currentE-energy)/temp)) {
+      _current = state.blockCoords();
+      _currentE = energy;
+      if (energy < bestEnergy) {
+        _best = _current;
+        bestEnergy = energy;
+      }
+    }
+
+    if (exchangeInterval > 0 && (iter+1) % exchangeInterval == 0) exchange(state);
+
+    // Set the final state
+    if (iter == maxIter) {
+      shareBest(state);
+      progress.energy = bestEnergy;
+    } else {
+      state.blockCoords(_current);
+      progress.energy = _currentE;
+    }
+  }
+
+
+  void ParallelTempering::exchange(State& state) {
+    // Alternate between exchanging the even and odd pairs of neighbouring temperatures
+    // The random numbers for all pairs are drawn on every processor, so that they agree without communication
+    int parity = ((iter+1) / exchangeInterval) % 2;
+    vector<double> random(nReplica());
+    _exchangeRng.setStep(_stepStart + iter).uniform(random);
+
+    int iRep = replica();
+    int iPartner = (iRep%2 == parity) ? iRep + 1 : iRep - 1;
+    if (iPartner < 0 || iPartner >= nReplica()) return;
+    int iLower = std::min(iRep, iPartner);
+    nExchangeAttempt++;
+
+#ifdef PARALLEL
+    // Each processor exchanges with the processor at the same position in the partner group
+    int partner = iPartner*_groupSize + mpi.rank%_groupSize;
+    int tag = iLower;
+    double partnerE;
+    MPI_Sendrecv(&_currentE, 1, MPI_DOUBLE, partner, tag, &partnerE, 1, MPI_DOUBLE, partner, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    double delta = (1/temperatures[iRep] - 1/temperatures[iPartner]) * (_currentE - partnerE);
+    if (delta < 0 && random[iLower] >= exp(delta)) return;
+
+    // Swap the configurations (the groups have the same decomposition, so the blocks are the same size)
+    MPI_Sendrecv_replace(_current.data(), _current.size(), MPI_DOUBLE, partner, tag, partner, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    _currentE = partnerE;
+    nExchange++;
+#endif
+  }
+
+
+  void ParallelTempering::shareBest(State& state) {
+    // Find the replica with the lowest energy, and send its configuration to the other replicas
+    int iBest = replica();
+#ifdef PARALLEL
+    struct { double e; int rank; } local = {bestEnergy, replica()}, global;
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE_INT, MPI_MINLOC, MPI_COMM_WORLD);
+    bestEnergy = global.e;
+    iBest = global.rank;
+    int iPos = mpi.rank % _groupSize;
+    if (replica() == iBest) {
+      for (int iRep=0; iRep<nReplica(); iRep++) {
+        if (iRep == iBest) continue;
+        MPI_Send(_best.data(), _best.size(), MPI_DOUBLE, iRep*_groupSize + iPos, 0, MPI_COMM_WORLD);
+      }
+    } else {
+      MPI_Recv(_best.data(), _best.size(), MPI_DOUBLE, iBest*_groupSize + iPos, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+#endif
+    state.blockCoords(_best);
+  }
+
+}
@@ -1,31 +1,150 @@
 #include "linesearch.h"
 
+#include <math.h>
+#include <algorithm>
+#include <utility>
 #include "State.h"
 #include "utils/vec.h"
 
 namespace minim {
 
-  double backtrackingLinesearch(State& state, std::vector<double>& step, double de0) {
+  double backtrackingLinesearch(State& state, std::vector<double>& step, double de0, double* eNew) {
     const double c = 0.5; // Armijo control parameter
     const double tau = 0.5; // Shrink factor
+    Stats::Timer timer(&state.stats, Stats::LINESEARCH);
 
     double t = - c * de0;
     double e0 = state.energy();
     double step_multiplier = 1;
-    vector<double> newCoords = state.blockCoords() + step;
+    const vector<double>& coords = state.blockCoords();
+    vector<double> newCoords = coords + step;
 
+    if (eNew) *eNew = NAN; // Unknown if the last trial fails
     for (int i=0; i<10; i++) {
       double e = state.energy(newCoords);
-      if (e0-e >= t) break;
+      if (e0-e >= t) {
+        if (eNew) *eNew = e;
+        break;
+      }
 
-      step = step * tau;
-      newCoords = state.blockCoords() + step;
+      // Shrink the step, updating the trial coordinates in place
+      for (size_t j=0; j<step.size(); j++) {
+        step[j] *= tau;
+        newCoords[j] = coords[j] + step[j];
+      }
       step_multiplier = step_multiplier * tau;
       t = t * tau;
     }
 
-    state.blockCoords(newCoords);
+    state.blockCoords(std::move(newCoords));
     return step_multiplier;
   }
 
+
+  // Minimiser of the cubic interpolating the energy and its derivative at a and b, safeguarded to lie inside the interval
+  static double cubicMinimum(double a, double ea, double dea, double b, double eb, double deb) {
+    double d1 = dea + deb - 3 * (ea - eb) / (a - b);
+    double disc = d1*d1 - dea*deb;
+    double lo = std::min(a, b);
+    double hi = std::max(a, b);
+    double margin = 0.1 * (hi - lo);
+    if (disc >= 0) {
+      double d2 = copysign(sqrt(disc), b - a);
+      double denom = deb - dea + 2*d2;
+      if (denom != 0) {
+        double t = b - (b - a) * (deb + d2 - d1) / denom;
+        if (t > lo + margin && t < hi - margin) return t;
+      }
+    }
+    return 0.5 * (a + b); // Bisect if the interpolation is unreliable
+  }
+
+
+  // Line search satisfying the strong Wolfe conditions (Nocedal & Wright, algorithms 3.5 and 3.6)
+  // The energy and gradient are evaluated together at each trial, and the processor gradient at the accepted point is
+  // returned in g so that it does not need to be recomputed by the minimiser
+  double wolfeLinesearch(State& state, std::vector<double>& step, double de0, std::vector<double>& g, double* eNew,
+                         const std::function<void(double)>& overlap) {
+    const double c1 = 1e-4; // Sufficient decrease parameter
+    const double c2 = 0.9; // Curvature parameter
+    const int maxTrials = 20;
+    Stats::Timer timer(&state.stats, Stats::LINESEARCH);
+    const Communicator& comm = *state.comm;
+
+    double e0 = state.energy();
+    int nTrials = 0;
+    double aCurrent = 0;
+    // Move to a trial point in place (no copy of the starting coordinates is kept), getting the total energy and
+    // directional derivative with one reduction
+    auto evaluate = [&](double a, double& e, double& de) {
+      vector<double>& coords = state.editBlockCoords();
+      for (size_t j=0; j<coords.size(); j++) coords[j] += (a - aCurrent) * step[j];
+      state.procEnergyGradient(&e, &g);
+      Reduction sums(comm);
+      int iE = sums.add(e);
+      int iDe = sums.addDot(g, step);
+      sums.start();
+      if (overlap) overlap(a);
+      sums.wait();
+      e = sums[iE];
+      de = sums[iDe];
+      nTrials++;
+      aCurrent = a;
+    };
+
+    // Bracketing phase: expand the step until an interval containing an acceptable point is found
+    double aLo = 0, eLo = e0, deLo = de0;
+    double aHi = 0, eHi = 0, deHi = 0;
+    double a = 1, e, de;
+    bool accepted = false;
+    bool bracketed = false;
+    while (nTrials < maxTrials) {
+      evaluate(a, e, de);
+      if (e > e0 + c1*a*de0 || (nTrials > 1 && e >= eLo)) {
+        aHi = a; eHi = e; deHi = de;
+        bracketed = true;
+        break;
+      }
+      if (fabs(de) <= -c2*de0) {
+        accepted = true;
+        break;
+      }
+      if (de >= 0) {
+        aHi = aLo; eHi = eLo; deHi = deLo;
+        aLo = a; eLo = e; deLo = de;
+        bracketed = true;
+        break;
+      }
+      aLo = a; eLo = e; deLo = de;
+      a *= 2;
+    }
+
+    // Zoom phase: shrink the interval [aLo, aHi] using cubic interpolation
+    while (bracketed && !accepted && nTrials < maxTrials) {
+      a = cubicMinimum(aLo, eLo, deLo, aHi, eHi, deHi);
+      evaluate(a, e, de);
+      if (e > e0 + c1*a*de0 || e >= eLo) {
+        aHi = a; eHi = e; deHi = de;
+      } else {
+        if (fabs(de) <= -c2*de0) {
+          accepted = true;
+          break;
+        }
+        if (de * (aHi - aLo) >= 0) {
+          aHi = aLo; eHi = eLo; deHi = deLo;
+        }
+        aLo = a; eLo = e; deLo = de;
+      }
+    }
+
+    // If no point satisfied the conditions, use the lowest energy point found. If no trial decreased the energy, the
+    // state returns to the starting point (a zero step) and is marked as failed, as the minimiser cannot progress.
+    if (!accepted && aCurrent != aLo) evaluate(aLo, e, de);
+    if (!accepted && aLo == 0) state.failed();
+
+    for (double& s : step) s *= aCurrent;
+    if (eNew) *eNew = e;
+    return aCurrent;
+  }
+
 }
@@ -2,11 +2,18 @@
 #define LINESEARCH_H
 
 #include <vector>
+#include <functional>
 
 namespace minim {
   class State;
   
-  double backtrackingLinesearch(State& state, std::vector<double>& step, double de0);
+  // Both return the step multiplier, and give the total energy at the new coordinates in eNew if it is known
+  // For the Wolfe linesearch, overlap is called with the step multiplier of each trial point (with its gradient in g)
+  // while the energy and slope are being summed, so the caller can start its own work for the point. The last call is
+  // for the accepted point.
+  double backtrackingLinesearch(State& state, std::vector<double>& step, double de0, double* eNew=nullptr);
+  double wolfeLinesearch(State& state, std::vector<double>& step, double de0, std::vector<double>& g, double* eNew=nullptr,
+                         const std::function<void(double)>& overlap=nullptr);
 }
 
 #endif
@@ -33,7 +33,9 @@ namespace minim {
     // }
 
     // Assign elements
-    elements = {};
+    int nNode = coords.size() / 3;
+    elements.clear();
+    elements.reserve(bondList.size() + hingeList.size() + (wallOn ? 2 : 1) * nNode);
     for (int iB=0; iB<(int)bondList.size(); iB++) {
       vector<int> idofs(6);
       for (int iN=0; iN<2; iN++) {
@@ -56,7 +58,7 @@ namespace minim {
       if (vec::all(vec::slice(fixed, idofs))) continue;
       elements.push_back({1, idofs, {kHinge[iH], theta0[iH]}});
     }
-    for (int iN=0; iN<(int)coords.size()/3; iN++) {
+    for (int iN=0; iN<nNode; iN++) {
       vector<int> idofs{3*iN, 3*iN+1, 3*iN+2};
       if (vec::all(vec::slice(fixed, idofs))) continue;
       // External force
@@ -387,6 +389,120 @@ namespace minim {
   }
 
 
+  // Hessian-vector products, computed as the directional derivative of the element gradients along v
+  void BarAndHinge::elementHessianVector(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const {
+    switch (el.type) {
+      case 0:
+        stretchingHessian(coords, v, el, hv);
+        break;
+      case 1:
+        bendingHessian(coords, v, el, hv);
+        break;
+      case 3:
+        substrateHessian(coords, v, el, hv);
+        break;
+    }
+  }
+
+
+  void BarAndHinge::stretchingHessian(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const {
+    vector<double> x1{coords[el.idof[0]], coords[el.idof[1]], coords[el.idof[2]]};
+    vector<double> x2{coords[el.idof[3]], coords[el.idof[4]], coords[el.idof[5]]};
+    vector<double> v1{v[el.idof[0]], v[el.idof[1]], v[el.idof[2]]};
+    vector<double> v2{v[el.idof[3]], v[el.idof[4]], v[el.idof[5]]};
+
+    auto dx = x1 - x2;
+    auto dv = v1 - v2;
+    auto l = vec::norm(dx);
+    auto dl = l - el.parameters[1];
+    double dldv = vec::dotProduct(dx, dv) / l;
+
+    // g1 = 2k (l-l0)/l dx
+    double factor = 2 * el.parameters[0];
+    double dxFactor = factor * dldv * el.parameters[1] / (l*l);
+    double dvFactor = factor * dl / l;
+    for (int i=0; i<3; i++) {
+      double hvi = dxFactor * dx[i] + dvFactor * dv[i];
+      (*hv)[el.idof[i]] += hvi;
+      (*hv)[el.idof[3+i]] -= hvi;
+    }
+  }
+
+
+  void BarAndHinge::bendingHessian(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const {
+    vector<double> x1{coords[el.idof[0]], coords[el.idof[1]], coords[el.idof[2]]};
+    vector<double> x2{coords[el.idof[3]], coords[el.idof[4]], coords[el.idof[5]]};
+    vector<double> x3{coords[el.idof[6]], coords[el.idof[7]], coords[el.idof[8]]};
+    vector<double> x4{coords[el.idof[9]], coords[el.idof[10]], coords[el.idof[11]]};
+    vector<double> v1{v[el.idof[0]], v[el.idof[1]], v[el.idof[2]]};
+    vector<double> v2{v[el.idof[3]], v[el.idof[4]], v[el.idof[5]]};
+    vector<double> v3{v[el.idof[6]], v[el.idof[7]], v[el.idof[8]]};
+    vector<double> v4{v[el.idof[9]], v[el.idof[10]], v[el.idof[11]]};
+
+    // Angle, as in bending
+    auto b1 = x2 - x1;
+    auto b2 = x3 - x2;
+    auto b3 = x4 - x3;
+    double b2m = vec::norm(b2);
+    auto n1 = vec::crossProduct(b1, b2);
+    auto n2 = vec::crossProduct(b2, b3);
+    double n1sq = vec::dotProduct(n1, n1);
+    double n2sq = vec::dotProduct(n2, n2);
+    double c = vec::dotProduct(n1, n2) / sqrt(n1sq * n2sq);
+    c = std::max(c, -1.0);
+    c = std::min(c,  1.0);
+    double theta = (vec::dotProduct(n1, b3)>=0) ? acos(c) : 2*pi()-acos(c);
+    double dtheta = theta - el.parameters[1];
+    dtheta = fmod(dtheta + pi(), 2*pi()) - pi();
+
+    // Gradient of the angle, g = k dtheta G
+    auto n1h = b2m/n1sq * n1;
+    auto n2h = b2m/n2sq * n2;
+    double skew1 = -vec::dotProduct(b1, b2) / (b2m*b2m);
+    double skew2 = -vec::dotProduct(b3, b2) / (b2m*b2m);
+    vector2d<double> G = {-n1h, (1-skew1)*n1h - skew2*n2h, skew1*n1h - (1-skew2)*n2h, n2h};
+
+    // Directional derivatives along v
+    auto db1 = v2 - v1;
+    auto db2 = v3 - v2;
+    auto db3 = v4 - v3;
+    double db2m = vec::dotProduct(b2, db2) / b2m;
+    auto dn1 = vec::crossProduct(db1, b2) + vec::crossProduct(b1, db2);
+    auto dn2 = vec::crossProduct(db2, b3) + vec::crossProduct(b2, db3);
+    auto dn1h = (db2m/n1sq - 2*b2m*vec::dotProduct(n1, dn1)/(n1sq*n1sq)) * n1 + b2m/n1sq * dn1;
+    auto dn2h = (db2m/n2sq - 2*b2m*vec::dotProduct(n2, dn2)/(n2sq*n2sq)) * n2 + b2m/n2sq * dn2;
+    double dskew1 = -(vec::dotProduct(db1, b2) + vec::dotProduct(b1, db2)) / (b2m*b2m) - 2*skew1*db2m/b2m;
+    double dskew2 = -(vec::dotProduct(db3, b2) + vec::dotProduct(b3, db2)) / (b2m*b2m) - 2*skew2*db2m/b2m;
+    vector2d<double> dG = {
+      -dn1h,
+      (1-skew1)*dn1h - dskew1*n1h - skew2*dn2h - dskew2*n2h,
+      skew1*dn1h + dskew1*n1h - (1-skew2)*dn2h + dskew2*n2h,
+      dn2h
+    };
+    double dthetadv = vec::dotProduct(G[0], v1) + vec::dotProduct(G[1], v2) + vec::dotProduct(G[2], v3) + vec::dotProduct(G[3], v4);
+
+    // H v = k (G.v) G + k dtheta dG
+    double k = el.parameters[0];
+    for (int iN=0; iN<4; iN++) {
+      for (int i=0; i<3; i++) {
+        (*hv)[el.idof[3*iN+i]] += k * (dthetadv * G[iN][i] + dtheta * dG[iN][i]);
+      }
+    }
+  }
+
+
+  void BarAndHinge::substrateHessian(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const {
+    double height = coords[el.idof[2]];
+    if (!wallAdhesion && height>0) return;
+    double lj_r0 = 0.858374218932559*lj_sigma;
+    if (height + lj_r0 < lj_r0/2) return; // The height is capped
+    height = height + lj_r0;
+    double lj9 = 2.0/15 * pow(lj_sigma / height, 9);
+    double lj3 = pow(lj_sigma / height, 3);
+    (*hv)[el.idof[2]] += lj_epsilon * (90*lj9 - 12*lj3) / pow(height, 2) * v[el.idof[2]];
+  }
+
+
   BarAndHinge& BarAndHinge::setTriangulation(const vector2d<int>& triList) {
     this->_triList = triList;
     return *this;
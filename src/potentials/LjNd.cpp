@@ -14,13 +14,15 @@ namespace minim {
     if (nDof % nDim != 0) throw std::invalid_argument("LjNd: Length of coords must be a multiple of the number of dimensions.");
     int nParticle = nDof / nDim;
     // Generate energy elements
-    elements = {};
+    int nPair = nParticle * (nParticle-1) / 2;
+    elements.clear();
+    elements.reserve(nPair, nPair*2*nDim);
+    vector<int> iDof(2*nDim);
     for (int i=0; i<nParticle; i++) {
       for (int j=i+1; j<nParticle; j++) {
-        vector<int> iDof(2*nDim);
         std::iota(iDof.begin(), iDof.begin()+nDim, nDim*i);
         std::iota(iDof.begin()+nDim, iDof.end(), nDim*j);
-        elements.push_back({0, iDof});
+        elements.push_back(0, iDof);
       }
     }
   }
@@ -53,6 +55,28 @@ namespace minim {
   }
 
 
+  void LjNd::elementHessianVector(const vector<double>& coords, const vector<double>& v, const Element& el, vector<double>* hv) const {
+    // Directional derivative of the gradient, g1 = factor(r2) dx
+    vector<double> dx(nDim);
+    vector<double> dv(nDim);
+    for (int iDim=0; iDim<nDim; iDim++) {
+      dx[iDim] = coords[el.idof[iDim]] - coords[el.idof[nDim+iDim]];
+      dv[iDim] = v[el.idof[iDim]] - v[el.idof[nDim+iDim]];
+    }
+    double r2 = vec::dotProduct(dx, dx);
+    double lj6 = pow(sigma, 6) / pow(r2, 3);
+    double lj12 = lj6 * lj6;
+
+    double factor = -24 * epsilon * (2*lj12 - lj6) / r2;
+    double dFactor = 24 * epsilon * (14*lj12 - 4*lj6) / (r2*r2) * 2*vec::dotProduct(dx, dv);
+    for (int iDim=0; iDim<nDim; iDim++) {
+      double hvi = dFactor * dx[iDim] + factor * dv[iDim];
+      (*hv)[el.idof[iDim]] += hvi;
+      (*hv)[el.idof[nDim+iDim]] -= hvi;
+    }
+  }
+
+
   LjNd& LjNd::setSigma(double sigma) {
     this->sigma = sigma;
     return *this;
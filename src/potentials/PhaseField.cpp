@@ -4,11 +4,16 @@
 #include <math.h>
 #include <stdexcept>
 #include <functional>
+#include <numeric>
 #include "State.h"
 #include "utils/vec.h"
 #include "utils/range.h"
 #include "communicators/CommGrid.h"
 #include "minimisers/Lbfgs.h"
+#include "utils/mpi.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 namespace minim {
@@ -220,18 +225,23 @@ namespace minim {
           volume[iFluid] += coordsLocal[iFluid+nFluid*iGrid] * nodeVol[iGrid];
         }
       }
-      for (int iFluid=0; iFluid<nFluid; iFluid++) {
-        volume[iFluid] = comm.sum(volume[iFluid]);
-      }
       totalVolume2 = 0;
       for (int iGrid : RangeI(procSizes, haloWidths)) {
         totalVolume2 += nodeVol[iGrid] * nodeVol[iGrid];
       }
-      totalVolume2 = comm.sum(totalVolume2);
+      Reduction sums(comm);
+      for (int iFluid=0; iFluid<nFluid; iFluid++) sums.add(volume[iFluid]);
+      int iTotal = sums.add(totalVolume2);
+      sums.reduce();
+      for (int iFluid=0; iFluid<nFluid; iFluid++) volume[iFluid] = sums[iFluid];
+      totalVolume2 = sums[iTotal];
     }
 
     // Set initial values for confinement potential
     if (vec::any(confinementStrength)) ffInit = coordsLocal;
+
+    // The diagonal of the preconditioner is only built if it is used
+    precondDiag.clear();
   }
 
 
@@ -281,6 +291,32 @@ namespace minim {
   }
 
 
+  // Diagonal of the Hessian of the phaseGradient terms
+  void PhaseField::phaseDiagonal(int iGrid, int iFluid, const vector<int>& neighbours, double factor, vector<double>& diag) const {
+    int i0 = iGrid * nFluid + iFluid;
+    for (int iDir=0; iDir<3; iDir++) {
+      if (procSizes[iDir] == 1) continue;
+
+      int imGrid = neighbours[2*iDir+0];
+      int ipGrid = neighbours[2*iDir+1];
+      int im = imGrid * nFluid + iFluid;
+      int ip = ipGrid * nFluid + iFluid;
+
+      if (!solid[imGrid] && !solid[ipGrid]) { // No solid
+        diag[i0] += 2 * factor;
+        diag[im] += factor;
+        diag[ip] += factor;
+      } else if (!solid[ipGrid]) { // Solid on negative side
+        diag[i0] += 2 * factor;
+        diag[ip] += 2 * factor;
+      } else if (!solid[imGrid]) { // Solid on positive side
+        diag[i0] += 2 * factor;
+        diag[im] += 2 * factor;
+      }
+    }
+  }
+
+
   inline void PhaseField::phasePairGradient(const vector<double>& coords, int iGrid, int iFluid1, int iFluid2, const vector<int>& xGrid,
                                             const vector<int>& neighbours, double factor, double* e, vector<double>* g) const {
     int i01 = iGrid * nFluid + iFluid1;
@@ -511,11 +547,14 @@ namespace minim {
     }
 
     // Get the difference in volumes
+    Reduction sums(comm);
+    for (int iFluid=0; iFluid<nFluid; iFluid++) sums.add(volFluid[iFluid]);
+    sums.reduce();
     vector<double> volDiff(nFluid, 0);
     vector<bool> volCorrect(nFluid, true);
     for (int iFluid=0; iFluid<nFluid; iFluid++) {
       if (fixFluid[iFluid] || volume[iFluid]<0) continue;
-      volDiff[iFluid] = comm.sum(volFluid[iFluid]) - volume[iFluid];
+      volDiff[iFluid] = sums[iFluid] - volume[iFluid];
       if (abs(volDiff[iFluid]) > volume[iFluid]) volCorrect[iFluid] = false;
     }
 
@@ -596,9 +635,12 @@ namespace minim {
       }
 
       // Finish the dot product and get (g.v) / |v|^2
+      Reduction sums(comm);
+      for (int iFluid=0; iFluid<nFluid; iFluid++) sums.add(component[iFluid]);
+      sums.reduce();
       for (int iFluid : iVariableFluid) {
         if (!volCorrect[iFluid]) continue;
-        component[iFluid] = comm.sum(component[iFluid]) / totalVolume2;
+        component[iFluid] = sums[iFluid] / totalVolume2;
       }
 
       // Remove the component, ie. g - (g.v) v / |v|^2
@@ -619,25 +661,229 @@ namespace minim {
 
 
   void PhaseField::energyGradient(const vector<double>& coords, const Communicator& comm, double* e, vector<double>* g) const {
-    if (g) *g = vector<double>(coords.size());
+    const vector<double>* coordsPtr = &coords;
+    sweepEnergyGradient(1, &coordsPtr, e, (g) ? &g : nullptr);
+  }
 
+
+  void PhaseField::batchEnergyGradient(const vector2d<double>& coords, const Communicator& comm, vector<double>* e, vector2d<double>* g) const {
+    int nSets = coords.size();
+    vector<const vector<double>*> coordsPtrs(nSets);
+    vector<vector<double>*> gPtrs((g) ? nSets : 0);
+    for (int k=0; k<nSets; k++) {
+      coordsPtrs[k] = &coords[k];
+      if (g) gPtrs[k] = &(*g)[k];
+    }
+    sweepEnergyGradient(nSets, coordsPtrs.data(), (e) ? e->data() : nullptr, (g) ? gPtrs.data() : nullptr);
+  }
+
+
+  void PhaseField::sweepEnergyGradient(int nSets, const vector<double>* const* coords, double* e, vector<double>* const* g) const {
+    for (int k=0; k<nSets; k++) {
+      if (e) e[k] = 0;
+      if (g) g[k]->assign(coords[k]->size(), 0); // Reuses the existing storage of g
+    }
+
+    // Compute the energy and gradient for the nodes with x in [xStart, xEnd)
+    // The coordinate sets are iterated over in the inner loop so that the node data is reused
+    auto slabEnergyGradient = [&](int xStart, int xEnd, double* e) {
+      vector<int> xGrid(3);
+      for (xGrid[0]=xStart; xGrid[0]<xEnd; xGrid[0]++) {
+        for (xGrid[1]=haloWidths[1]; xGrid[1]<procSizes[1]-haloWidths[1]; xGrid[1]++) {
+          for (xGrid[2]=haloWidths[2]; xGrid[2]<procSizes[2]-haloWidths[2]; xGrid[2]++) {
+            int iGrid = getIdx(xGrid, procSizes);
+            for (int k=0; k<nSets; k++) {
+              const vector<double>& c = *coords[k];
+              double* ek = (e) ? &e[k] : nullptr;
+              vector<double>* gk = (g) ? g[k] : nullptr;
+
+              if (model == MODEL_BASIC) {
+                fluidEnergy(c, iGrid, xGrid, ek, gk);
+              } else if (model == MODEL_NCOMP) {
+                fluidPairEnergy(c, iGrid, xGrid, ek, gk);
+              }
+
+              surfaceEnergy(c, iGrid, ek, gk);
+              pressureEnergy(c, iGrid, ek, gk);
+              densityConstraintEnergy(c, iGrid, ek, gk);
+              forceEnergy(c, iGrid, xGrid, ek, gk);
+              ffConfinementEnergy(c, iGrid, ek, gk);
+            }
+          }
+        }
+      }
+    };
+
+    // The x-range is split into an even number of chunks at least two nodes wide
+    // Nodes only write to the gradient of their nearest neighbours, so chunks of the same parity never
+    // write to the same gradient entries and can be evaluated at the same time. The chunks are used (in the same
+    // order) for any number of threads, including one, so the energy and gradient do not depend on it bitwise.
+    int xStart = haloWidths[0];
+    int xEnd = procSizes[0] - haloWidths[0];
+    int nx = xEnd - xStart;
+    int nChunks = 2 * (nx / 4);
+    if (nChunks < 2) {
+      slabEnergyGradient(xStart, xEnd, e);
+      return;
+    }
+
+    vector<double> eChunks(nChunks*nSets, 0);
+#ifdef _OPENMP
+    #pragma omp parallel num_threads((nThreads == 0) ? omp_get_max_threads() : nThreads)
+#endif
+    for (int parity=0; parity<2; parity++) {
+#ifdef _OPENMP
+      #pragma omp for schedule(static)
+#endif
+      for (int iChunk=parity; iChunk<nChunks; iChunk+=2) {
+        slabEnergyGradient(xStart + iChunk*nx/nChunks, xStart + (iChunk+1)*nx/nChunks, (e) ? &eChunks[iChunk*nSets] : nullptr);
+      }
+    }
+    if (e) {
+      for (int iChunk=0; iChunk<nChunks; iChunk++) {
+        for (int k=0; k<nSets; k++) e[k] += eChunks[iChunk*nSets+k];
+      }
+    }
+  }
+
+
+  void PhaseField::hessianVector(const vector<double>& coords, const vector<double>& v, const Communicator& comm, vector<double>* hv) const {
+    hv->assign(coords.size(), 0); // Reuses the existing storage of hv
     vector<int> xGrid(3);
     for (xGrid[0]=haloWidths[0]; xGrid[0]<procSizes[0]-haloWidths[0]; xGrid[0]++) {
       for (xGrid[1]=haloWidths[1]; xGrid[1]<procSizes[1]-haloWidths[1]; xGrid[1]++) {
         for (xGrid[2]=haloWidths[2]; xGrid[2]<procSizes[2]-haloWidths[2]; xGrid[2]++) {
-          int iGrid = getIdx(xGrid, procSizes);
+          nodeHessianVector(coords, v, getIdx(xGrid, procSizes), xGrid, hv);
+        }
+      }
+    }
+  }
 
-          if (model == MODEL_BASIC) {
-            fluidEnergy(coords, iGrid, xGrid, e, g);
-          } else if (model == MODEL_NCOMP) {
-            fluidPairEnergy(coords, iGrid, xGrid, e, g);
+
+  void PhaseField::nodeHessianVector(const vector<double>& coords, const vector<double>& v, int iGrid, const vector<int>& xGrid, vector<double>* hv) const {
+    // The gradient energy terms are quadratic, so their Hessian-vector product is their gradient evaluated at v
+    // The pressure and force terms are linear and do not contribute
+    auto gQuartic2 = [](double c){ return 12*c*c - 12*c + 2; };
+    double res2 = pow(resolution, 2);
+
+    if (model == MODEL_BASIC) {
+      for (int iFluid=0; iFluid<nFluid; iFluid++) {
+        int iDof = iGrid * nFluid + iFluid;
+        double c = coords[iDof];
+        int iK = ((int)kappa.size()==nFluid) ? iFluid : iGrid*nFluid+iFluid;
+        if (nFluid == 1) {
+          (*hv)[iDof] += kappa[iK] / 16 * nodeVol[iGrid] * (12*c*c - 4) * v[iDof];
+        } else {
+          (*hv)[iDof] += 0.5 * kappa[iK] * nodeVol[iGrid] * gQuartic2(c) * v[iDof];
+        }
+        double factor = (nFluid==1) ? 0.25*kappaP[iK]*nodeVol[iGrid] : 0.5*kappaP[iK]*nodeVol[iGrid];
+        phaseGradient(v, iGrid, iFluid, xGrid, neighbours[iGrid], factor/res2, nullptr, hv);
+      }
+
+    } else if (model == MODEL_NCOMP) {
+      int iPair = 0;
+      for (int iFluid1=0; iFluid1<nFluid; iFluid1++) {
+        for (int iFluid2=iFluid1+1; iFluid2<nFluid; iFluid2++) {
+          int iDof1 = iGrid * nFluid + iFluid1;
+          int iDof2 = iGrid * nFluid + iFluid2;
+          double c1 = coords[iDof1];
+          double c2 = coords[iDof2];
+          int iK = ((int)kappa.size()==nParams) ? iPair : iGrid*nParams+iPair;
+          double factor = 2 * kappa[iK] * nodeVol[iGrid];
+          double h12 = gQuartic2(c1 + c2);
+          (*hv)[iDof1] += factor * ((gQuartic2(c1) + h12) * v[iDof1] + h12 * v[iDof2]);
+          (*hv)[iDof2] += factor * (h12 * v[iDof1] + (gQuartic2(c2) + h12) * v[iDof2]);
+          factor = -0.25 * kappaP[iK] * nodeVol[iGrid] / res2;
+          phasePairGradient(v, iGrid, iFluid1, iFluid2, xGrid, neighbours[iGrid], factor, nullptr, hv);
+          iPair++;
+        }
+      }
+    }
+
+    // Surface energy
+    if (nFluid==1 && surfaceArea[iGrid]!=0 && !contactAngle.empty() && contactAngle[iGrid]!=90) {
+      double wettingParam = 1/sqrt(2.0) * cos(contactAngle[iGrid] * 3.1415926536/180);
+      (*hv)[iGrid] += wettingParam * 2 * coords[iGrid] * surfaceArea[iGrid] * v[iGrid];
+    }
+
+    // Density soft constraint
+    if (nFluid>1 && densityConstraint==DENSITY_SOFT) {
+      double coef = densityConst * surfaceTensionMean * res2;
+      double vSum = 0;
+      for (int iFluid=0; iFluid<nFluid; iFluid++) vSum += v[iGrid*nFluid+iFluid];
+      for (int iFluid=0; iFluid<nFluid; iFluid++) (*hv)[iGrid*nFluid+iFluid] += 2 * coef * vSum;
+    }
+
+    // Confinement
+    for (int iFluid=0; iFluid<nFluid; iFluid++) {
+      if (confinementStrength[iFluid] == 0) continue;
+      int iDof = iGrid*nFluid+iFluid;
+      double coef = confinementStrength[iFluid] * surfaceTensionMean * res2;
+      if ((ffInit[iDof]-0.5)*(coords[iDof]-0.5) < 0) (*hv)[iDof] += coef * 2 * v[iDof];
+    }
+  }
+
+
+  // Coefficients of the bulk curvature at the minima and of the gradient energy for a node
+  void PhaseField::precondCoefficients(int iGrid, int iFluid, double* bulk, double* grad) const {
+    int iK = ((int)kappa.size()==nFluid) ? iFluid : iGrid*nFluid+iFluid;
+    *bulk = (nFluid==1) ? 0.5*kappa[iK]*nodeVol[iGrid] : kappa[iK]*nodeVol[iGrid];
+    *grad = (nFluid==1) ? 0.25*kappaP[iK]*nodeVol[iGrid] : 0.5*kappaP[iK]*nodeVol[iGrid];
+    *grad /= pow(resolution, 2);
+  }
+
+
+  void PhaseField::precondOperator(const vector<double>& v, vector<double>* mv) const {
+    mv->assign(v.size(), 0);
+    vector<int> xGrid(3);
+    for (xGrid[0]=haloWidths[0]; xGrid[0]<procSizes[0]-haloWidths[0]; xGrid[0]++) {
+      for (xGrid[1]=haloWidths[1]; xGrid[1]<procSizes[1]-haloWidths[1]; xGrid[1]++) {
+        for (xGrid[2]=haloWidths[2]; xGrid[2]<procSizes[2]-haloWidths[2]; xGrid[2]++) {
+          int iGrid = getIdx(xGrid, procSizes);
+          for (int iFluid=0; iFluid<nFluid; iFluid++) {
+            double bulk, grad;
+            precondCoefficients(iGrid, iFluid, &bulk, &grad);
+            (*mv)[iGrid*nFluid+iFluid] += bulk * v[iGrid*nFluid+iFluid];
+            phaseGradient(v, iGrid, iFluid, xGrid, neighbours[iGrid], grad, nullptr, mv);
           }
+        }
+      }
+    }
+  }
+
 
-          surfaceEnergy(coords, iGrid, e, g);
-          pressureEnergy(coords, iGrid, e, g);
-          densityConstraintEnergy(coords, iGrid, e, g);
-          forceEnergy(coords, iGrid, xGrid, e, g);
-          ffConfinementEnergy(coords, iGrid, e, g);
+  void PhaseField::precondition(const vector<double>& coords, const vector<double>& r, const Communicator& comm, vector<double>* z) const {
+    // Diagonal of M, built on the first call (on every processor, as it accumulates the halo contributions)
+    if (precondDiag.empty()) {
+      precondDiag.assign(nGrid*nFluid, 0);
+      for (int iGrid : RangeI(procSizes, haloWidths)) {
+        for (int iFluid=0; iFluid<nFluid; iFluid++) {
+          double bulk, grad;
+          precondCoefficients(iGrid, iFluid, &bulk, &grad);
+          precondDiag[iGrid*nFluid+iFluid] += bulk;
+          phaseDiagonal(iGrid, iFluid, neighbours[iGrid], grad, precondDiag);
+        }
+      }
+      if (comm.size() > 1) comm.communicateAccumulate(precondDiag);
+    }
+
+    // Jacobi iteration, starting from z = 0 so that a fixed number of sweeps gives a symmetric positive definite operator
+    // The halo of z is communicated before each application of M, and the contributions to the halo are accumulated
+    z->assign(r.size(), 0);
+    for (int iGrid : RangeI(procSizes, haloWidths)) {
+      for (int i=iGrid*nFluid; i<(iGrid+1)*nFluid; i++) {
+        (*z)[i] = (precondDiag[i] > 0) ? r[i] / precondDiag[i] : r[i];
+      }
+    }
+
+    vector<double> mz;
+    for (int iSweep=1; iSweep<preconditionerSweeps; iSweep++) {
+      comm.communicate(*z);
+      precondOperator(*z, &mz);
+      if (comm.size() > 1) comm.communicateAccumulate(mz);
+      for (int iGrid : RangeI(procSizes, haloWidths)) {
+        for (int i=iGrid*nFluid; i<(iGrid+1)*nFluid; i++) {
+          if (precondDiag[i] > 0) (*z)[i] += (r[i] - mz[i]) / precondDiag[i];
         }
       }
     }
@@ -677,9 +923,12 @@ namespace minim {
 
     if (volumeFixed) volumeConstraintEnergy(coords, comm, &e["volume constraint"], &g["volume constraint"]);
 
+    Reduction sums(comm);
+    for(const auto &component : components) sums.add(e[component]);
+    sums.reduce();
     std::map<std::string,vector<double>> eg;
-    for(const auto &component : components) {
-      eg[component] = {comm.sum(e[component]), vec::norm(comm.gather(g[component]))};
+    for (size_t i=0; i<components.size(); i++) {
+      eg[components[i]] = {sums[i], vec::norm(comm.gather(g[components[i]]))};
     }
     return eg;
   }
@@ -702,6 +951,11 @@ namespace minim {
     return *this;
   }
 
+  PhaseField& PhaseField::setPreconditionerSweeps(int nSweeps) {
+    this->preconditionerSweeps = nSweeps;
+    return *this;
+  }
+
   PhaseField& PhaseField::setInterfaceSize(double interfaceSize) {
     this->interfaceSize = vector<double>(nFluid, interfaceSize);
     return *this;
@@ -975,4 +1229,151 @@ namespace minim {
     return minimum;
   }
 
+
+  static vector<int> coarseGridSize(const vector<int>& gridSize) {
+    vector<int> coarseSize(3);
+    for (int iDim=0; iDim<3; iDim++) {
+      if (gridSize[iDim] != 1 && gridSize[iDim] % 2 != 0) {
+        throw std::invalid_argument("PhaseField: The grid size must be even to coarsen.");
+      }
+      coarseSize[iDim] = (gridSize[iDim] == 1) ? 1 : gridSize[iDim] / 2;
+    }
+    return coarseSize;
+  }
+
+
+  PhaseField PhaseField::coarsen() const {
+    // A coarse node is solid if any of the fine nodes it covers are solid, so that thin walls are kept
+    // The other node parameters are taken from the first fine node it covers
+    PhaseField coarse = *this;
+    vector<int> coarseSize = coarseGridSize(gridSize);
+    coarse.setGridSize(coarseSize);
+    coarse.setResolution(2 * resolution);
+    if (interfaceSize.empty()) coarse.interfaceSize = vector<double>(nFluid, resolution); // Keep the physical interface size
+    coarse.commArray = {};
+
+    auto fineIdx = [&](int iCoarse) {
+      vector<int> x = getCoord(iCoarse, coarseSize);
+      for (int iDim=0; iDim<3; iDim++) x[iDim] *= gridSize[iDim] / coarseSize[iDim];
+      return getIdx(x, gridSize);
+    };
+    auto inject = [&](const vector<double>& fine) {
+      int nPerNode = fine.size() / nGrid;
+      vector<double> out(coarse.nGrid*nPerNode);
+      for (int i=0; i<coarse.nGrid; i++) {
+        for (int j=0; j<nPerNode; j++) out[i*nPerNode+j] = fine[fineIdx(i)*nPerNode+j];
+      }
+      return out;
+    };
+
+    if (!solid.empty()) {
+      coarse.solid = vector<char>(coarse.nGrid, false);
+      for (int iGrid=0; iGrid<nGrid; iGrid++) {
+        if (!solid[iGrid]) continue;
+        vector<int> x = getCoord(iGrid, gridSize);
+        for (int iDim=0; iDim<3; iDim++) x[iDim] /= gridSize[iDim] / coarseSize[iDim];
+        coarse.solid[getIdx(x, coarseSize)] = true;
+      }
+    }
+    if (!contactAngle.empty()) coarse.contactAngle = inject(contactAngle);
+    if (surfaceTension.size() > 1 && (int)surfaceTension.size() % nGrid == 0) coarse.surfaceTension = inject(surfaceTension);
+    return coarse;
+  }
+
+
+  vector<double> PhaseField::restrictCoords(const vector<double>& coords) const {
+    vector<int> coarseSize = coarseGridSize(gridSize);
+    int nCoarse = vec::product(coarseSize);
+    vector<double> coarse(nCoarse*nFluid, 0);
+    vector<double> count(nCoarse, 0);
+    for (int iGrid=0; iGrid<nGrid; iGrid++) {
+      vector<int> x = getCoord(iGrid, gridSize);
+      for (int iDim=0; iDim<3; iDim++) x[iDim] /= gridSize[iDim] / coarseSize[iDim];
+      int iCoarse = getIdx(x, coarseSize);
+      count[iCoarse]++;
+      for (int iFluid=0; iFluid<nFluid; iFluid++) coarse[iCoarse*nFluid+iFluid] += coords[iGrid*nFluid+iFluid];
+    }
+    for (int i=0; i<nCoarse; i++) {
+      for (int iFluid=0; iFluid<nFluid; iFluid++) coarse[i*nFluid+iFluid] /= count[i];
+    }
+    return coarse;
+  }
+
+
+  vector<double> PhaseField::prolongCoords(const vector<double>& coarseCoords) const {
+    // Multilinear interpolation, with the fine node 2x at the coarse node x, and periodic boundaries
+    vector<int> coarseSize = coarseGridSize(gridSize);
+    vector<double> fine(nGrid*nFluid, 0);
+    for (int iGrid=0; iGrid<nGrid; iGrid++) {
+      vector<int> x = getCoord(iGrid, gridSize);
+      vector<int> x0(3);
+      vector<double> t(3);
+      for (int iDim=0; iDim<3; iDim++) {
+        int ratio = gridSize[iDim] / coarseSize[iDim];
+        x0[iDim] = x[iDim] / ratio;
+        t[iDim] = (double)(x[iDim] % ratio) / ratio;
+      }
+      for (int corner=0; corner<8; corner++) {
+        vector<int> xCorner = x0;
+        double weight = 1;
+        for (int iDim=0; iDim<3; iDim++) {
+          bool upper = (corner >> iDim) & 1;
+          xCorner[iDim] += upper;
+          weight *= (upper) ? t[iDim] : 1 - t[iDim];
+        }
+        if (weight == 0) continue;
+        int iCoarse = getIdx(xCorner, coarseSize);
+        for (int iFluid=0; iFluid<nFluid; iFluid++) {
+          fine[iGrid*nFluid+iFluid] += weight * coarseCoords[iCoarse*nFluid+iFluid];
+        }
+      }
+    }
+    return fine;
+  }
+
+
+  State PhaseField::multilevelMinimise(const vector<double>& coords, Minimiser& minimiser, int nLevels, vector<int> ranks) const {
+    const int minBlockSize = 4; // Minimum nodes along each dimension of a processor block on the coarse levels
+    if (ranks.empty()) {
+      ranks = vector<int>(mpi.size);
+      std::iota(ranks.begin(), ranks.end(), 0);
+    }
+
+    // Build the levels from fine to coarse
+    // The processors along each dimension are reduced if the coarse grid can not be split evenly into large enough blocks
+    vector<PhaseField> levels = {*this};
+    vector<vector<int>> levelRanks = {ranks};
+    if (levels[0].commArray.empty()) levels[0].commArray = assignCommArray(ranks.size(), gridSize);
+    auto canCoarsen = [](const vector<int>& size) {
+      for (int n : size) if (n != 1 && (n % 2 != 0 || n < 8)) return false;
+      return true;
+    };
+    while ((nLevels > 0) ? (int)levels.size() < nLevels : canCoarsen(levels.back().gridSize)) {
+      const PhaseField& fine = levels.back();
+      PhaseField coarse = fine.coarsen();
+      vector<int> commArray = fine.commArray;
+      for (int iDim=0; iDim<3; iDim++) {
+        int n = coarse.gridSize[iDim];
+        while (commArray[iDim] > 1 && (n % commArray[iDim] != 0 || n / commArray[iDim] < minBlockSize)) commArray[iDim]--;
+      }
+      coarse.setCommArray(commArray);
+      levelRanks.push_back(vector<int>(ranks.begin(), ranks.begin() + vec::product(commArray)));
+      levels.push_back(coarse);
+    }
+
+    // Restrict the initial coordinates to the coarsest grid
+    vector<double> x = coords;
+    for (int iLevel=0; iLevel<(int)levels.size()-1; iLevel++) x = levels[iLevel].restrictCoords(x);
+
+    // Minimise from coarse to fine
+    for (int iLevel=levels.size()-1; iLevel>0; iLevel--) {
+      State state = levels[iLevel].newState(x, levelRanks[iLevel]);
+      minimiser.minimise(state);
+      x = levels[iLevel-1].prolongCoords(state.allCoords());
+    }
+    State state = levels[0].newState(x, ranks);
+    minimiser.minimise(state);
+    return state;
+  }
+
 }
@@ -156,7 +156,7 @@ namespace minim {
     }
 
     // Assign elements
-    elements = {};
+    elements.clear();
     for (int iGrid=0; iGrid<nGrid; iGrid++) {
       if (solid[iGrid]) continue;
 
@@ -290,7 +290,10 @@ namespace minim {
         volFluid[fluidType[iDof]] += coords[iDof] * nodeVol[iDof];
       }
     }
-    for (double &vol : volFluid) vol = comm.sum(vol);
+    Reduction sums(comm);
+    for (double vol : volFluid) sums.add(vol);
+    sums.reduce();
+    for (int iFluid=0; iFluid<nFluid; iFluid++) volFluid[iFluid] = sums[iFluid];
 
     // Compute the energy and gradient
     double volCoef = volConst * surfaceTensionMean / pow(resolution, 4);
@@ -308,7 +311,7 @@ namespace minim {
   }
 
 
-  void phaseGradient(const vector<double>& coords, const vector<int> idof, double factor, double* e, vector<double>* g) {
+  void phaseGradient(const vector<double>& coords, ArrayView<const int> idof, double factor, double* e, vector<double>* g) {
     double c1 = coords[idof[0]];
     double grad2 = 0;
 
@@ -563,7 +566,9 @@ namespace minim {
 
     // All other fluids
     for (int iFluid=0; iFluid<nFluid-1; iFluid++) {
-      vector<int> idof = el.idof + iFluid;
+      std::array<int,7> idofArray;
+      for (int i=0; i<nNodes; i++) idofArray[i] = el.idof[i] + iFluid;
+      ArrayView<const int> idof(idofArray.data(), nNodes);
 
       // Bulk energy
       double c = coords[idof[0]];
@@ -0,0 +1,71 @@
+#include "utils/AsyncLog.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace minim {
+
+  struct AsyncLog::Impl {
+    std::ostream& out;
+    std::deque<std::string> queue;
+    bool writing = false;
+    bool stop = false;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable written;
+    std::thread thread;
+
+    Impl(std::ostream& out) : out(out) {
+      thread = std::thread([this]{ run(); });
+    }
+
+    ~Impl() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      queued.notify_one();
+      thread.join();
+    }
+
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        queued.wait(lock, [this]{ return stop || !queue.empty(); });
+        if (queue.empty()) return; // Only stops once the queue is empty
+
+        // Write the queued lines without holding the lock
+        std::deque<std::string> lines;
+        lines.swap(queue);
+        writing = true;
+        lock.unlock();
+        for (const auto& line : lines) out << line << "\n";
+        out.flush();
+        lock.lock();
+        writing = false;
+        written.notify_all();
+      }
+    }
+  };
+
+
+  AsyncLog::AsyncLog(std::ostream& out) : _impl(std::make_shared<Impl>(out)) {}
+
+
+  void AsyncLog::operator()(const std::string& line) const {
+    {
+      std::lock_guard<std::mutex> lock(_impl->mutex);
+      _impl->queue.push_back(line);
+    }
+    _impl->queued.notify_one();
+  }
+
+
+  void AsyncLog::flush() const {
+    std::unique_lock<std::mutex> lock(_impl->mutex);
+    _impl->written.wait(lock, [this]{ return _impl->queue.empty() && !_impl->writing; });
+  }
+
+}
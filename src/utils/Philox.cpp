@@ -0,0 +1,99 @@
+#include "utils/Philox.h"
+
+namespace minim {
+
+  namespace {
+    constexpr uint32_t M0 = 0xD2511F53;
+    constexpr uint32_t M1 = 0xCD9E8D57;
+    constexpr uint32_t W0 = 0x9E3779B9;
+    constexpr uint32_t W1 = 0xBB67AE85;
+    constexpr int ROUNDS = 10;
+
+    // The Philox rounds for several counters at once, with the counters in the inner loop so that they can be vectorised
+    template<int N>
+    inline void rounds(uint32_t (&x)[4][N], Philox::Key key) {
+      for (int r=0; r<ROUNDS; r++) {
+        for (int l=0; l<N; l++) {
+          uint64_t p0 = (uint64_t)M0 * x[0][l];
+          uint64_t p1 = (uint64_t)M1 * x[2][l];
+          uint32_t y0 = (uint32_t)(p1 >> 32) ^ x[1][l] ^ key[0];
+          uint32_t y2 = (uint32_t)(p0 >> 32) ^ x[3][l] ^ key[1];
+          x[0][l] = y0;
+          x[1][l] = (uint32_t)p1;
+          x[2][l] = y2;
+          x[3][l] = (uint32_t)p0;
+        }
+        key[0] += W0;
+        key[1] += W1;
+      }
+    }
+
+    // Uniform in [0, 1) from 53 bits of two random integers
+    inline double toUniform(uint32_t a, uint32_t b) {
+      return ((uint64_t)(a >> 5) * 67108864 + (b >> 6)) * (1.0 / 9007199254740992.0);
+    }
+  }
+
+
+  Philox::Philox(uint64_t seed, uint32_t stream, uint32_t subStream)
+    : _key({(uint32_t)seed, (uint32_t)(seed >> 32)}), _counter({0, 0, stream, subStream}) {}
+
+
+  Philox& Philox::setStep(uint32_t step) {
+    _counter[0] = 0;
+    _counter[1] = step;
+    _used = 4;
+    return *this;
+  }
+
+
+  Philox::result_type Philox::operator()() {
+    if (_used == 4) {
+      _buffer = block(_counter, _key);
+      _counter[0]++;
+      _used = 0;
+    }
+    return _buffer[_used++];
+  }
+
+
+  double Philox::uniform() {
+    uint32_t a = (*this)();
+    uint32_t b = (*this)();
+    return toUniform(a, b);
+  }
+
+
+  void Philox::uniform(double* out, size_t n, double lo, double hi) {
+    // Each block gives two numbers, and the batch starts from a new block
+    constexpr int N = 8;
+    double range = hi - lo;
+    _used = 4;
+    for (size_t i=0; i<n; i+=2*N) {
+      uint32_t x[4][N];
+      for (int l=0; l<N; l++) {
+        x[0][l] = _counter[0] + l;
+        x[1][l] = _counter[1];
+        x[2][l] = _counter[2];
+        x[3][l] = _counter[3];
+      }
+      rounds(x, _key);
+      _counter[0] += N;
+
+      size_t nBatch = (n-i < 2*N) ? n-i : 2*N;
+      for (size_t j=0; j<nBatch; j++) {
+        int l = j / 2;
+        double u = (j % 2 == 0) ? toUniform(x[0][l], x[1][l]) : toUniform(x[2][l], x[3][l]);
+        out[i+j] = lo + range * u;
+      }
+    }
+  }
+
+
+  Philox::Block Philox::block(Block counter, Key key) {
+    uint32_t x[4][1] = {{counter[0]}, {counter[1]}, {counter[2]}, {counter[3]}};
+    rounds(x, key);
+    return {x[0][0], x[1][0], x[2][0], x[3][0]};
+  }
+
+}
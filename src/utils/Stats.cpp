@@ -0,0 +1,127 @@
+#include "utils/Stats.h"
+
+#include <sstream>
+#include <iomanip>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace minim {
+
+  const char* Stats::phaseName(Phase phase) {
+    static const char* names[NPHASE] = {"pot", "constraints", "halo", "accumulate", "reduce", "gather", "linesearch", "iter"};
+    return names[phase];
+  }
+
+
+  // Cycle and cache miss counters for the calling thread, closed when the last copy of the Stats is destroyed
+  struct Stats::HardwareCounters {
+    int fd[2] = {-1, -1};
+
+    HardwareCounters() {
+#ifdef __linux__
+      unsigned long long configs[2] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES};
+      for (int i=0; i<2; i++) {
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd[i] >= 0) ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+    }
+
+    ~HardwareCounters() {
+#ifdef __linux__
+      for (int i=0; i<2; i++) if (fd[i] >= 0) close(fd[i]);
+#endif
+    }
+
+    bool valid() const { return fd[0] >= 0 && fd[1] >= 0; }
+
+    long read(int i) const {
+      long long value = 0;
+#ifdef __linux__
+      if (::read(fd[i], &value, sizeof(value)) != sizeof(value)) return 0;
+#endif
+      return value;
+    }
+  };
+
+
+  void Stats::reset() {
+    nEnergy = 0;
+    nGradient = 0;
+    nHessian = 0;
+    for (int i=0; i<NPHASE; i++) {
+      nCalls[i] = 0;
+      time[i] = 0;
+    }
+    bytes = 0;
+    cycles = 0;
+    cacheMisses = 0;
+  }
+
+
+  bool Stats::enableHardwareCounters() {
+    auto hw = std::make_shared<HardwareCounters>();
+    if (!hw->valid()) return false;
+    _hw = hw;
+    return true;
+  }
+
+
+  std::string Stats::str() const {
+    std::ostringstream out;
+    out << std::setprecision(3);
+    out << "nE: " << nEnergy << "  nG: " << nGradient;
+    if (nHessian > 0) out << "  nHv: " << nHessian;
+    for (int i=0; i<NPHASE; i++) {
+      if (nCalls[i] == 0) continue;
+      out << "  " << phaseName((Phase)i) << ": " << nCalls[i] << "/" << time[i] << "s";
+    }
+    if (bytes > 0) out << "  bytes: " << bytes;
+    if (_hw) out << "  cycles: " << cycles << "  cache-misses: " << cacheMisses;
+    return out.str();
+  }
+
+
+  Stats& Stats::operator-=(const Stats& other) {
+    nEnergy -= other.nEnergy;
+    nGradient -= other.nGradient;
+    nHessian -= other.nHessian;
+    for (int i=0; i<NPHASE; i++) {
+      nCalls[i] -= other.nCalls[i];
+      time[i] -= other.time[i];
+    }
+    bytes -= other.bytes;
+    cycles -= other.cycles;
+    cacheMisses -= other.cacheMisses;
+    return *this;
+  }
+
+
+  void Stats::Timer::start() {
+    if (_phase == POTENTIAL && _stats->_hw) {
+      for (int i=0; i<2; i++) _hwStart[i] = _stats->_hw->read(i);
+    }
+    _start = std::chrono::steady_clock::now();
+  }
+
+  void Stats::Timer::stop() {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _start;
+    _stats->nCalls[_phase]++;
+    _stats->time[_phase] += elapsed.count();
+    if (_phase == POTENTIAL && _stats->_hw) {
+      _stats->cycles += _stats->_hw->read(0) - _hwStart[0];
+      _stats->cacheMisses += _stats->_hw->read(1) - _hwStart[1];
+    }
+  }
+
+}
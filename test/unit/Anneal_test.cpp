@@ -0,0 +1,111 @@
+#include "test_main.cpp"
+#include "minimisers/Anneal.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include "State.h"
+#include "potentials/LjNd.h"
+#include "potentials/FunctionPotential.h"
+#include "utils/mpi.h"
+
+using namespace minim;
+
+
+TEST(AnnealTest, TestLocalMoves) {
+  // At zero temperature the energy must never increase if the local energy changes are exact
+  Anneal anneal(1e-12, 0.05);
+  anneal.setLocalMoves(true).setMaxIter(4);
+  Lj2d pot;
+  std::vector<double> init = {0,0, 1.5,0, 0,1.5, 1.5,1.5, 3,0, 3,1.5, 0,3, 3,3};
+  State s = pot.newState(init);
+  double e0 = s.energy();
+  double ePrev = e0;
+  for (int i=0; i<50; i++) {
+    anneal.minimise(s);
+    double e = s.energy();
+    EXPECT_LE(e, ePrev + 1e-12);
+    ePrev = e;
+  }
+  EXPECT_LT(ePrev, e0 - 1);
+}
+
+
+TEST(AnnealTest, TestLocalMovesFixed) {
+  Anneal anneal(1e-12, 0.05);
+  anneal.setLocalMoves(true).setMaxIter(20);
+  Lj2d pot;
+  pot.setConstraints({0, 1});
+  std::vector<double> init = {0,0, 1.5,0, 0,1.5, 1.5,1.5};
+  State s = pot.newState(init);
+  anneal.minimise(s);
+  std::vector<double> coords = s.coords();
+  EXPECT_EQ(coords[0], 0);
+  EXPECT_EQ(coords[1], 0);
+}
+
+
+TEST(AnnealTest, TestLocalMovesSerial) {
+  auto pot = makePotential([](const std::vector<double>& x, double* e, std::vector<double>* g) {
+    if (e) *e = x[0]*x[0];
+    if (g) *g = {2*x[0]};
+  });
+  State s = pot.newState({1});
+  Anneal anneal(1, 0.1);
+  anneal.setLocalMoves(true);
+  EXPECT_THROW(anneal.minimise(s), std::invalid_argument);
+}
+
+
+TEST(AnnealTest, TestReproducible) {
+  Lj2d pot;
+  std::vector<double> init = {0,0, 1.5,0, 0,1.5, 1.5,1.5};
+  std::vector<std::vector<double>> results;
+  for (unsigned seed : {1, 1, 2}) {
+    Anneal anneal(0.1, 0.05);
+    anneal.setSeed(seed).setMaxIter(100);
+    State s = pot.newState(init);
+    results.push_back(anneal.minimise(s));
+  }
+  EXPECT_EQ(results[0], results[1]);
+  EXPECT_NE(results[0], results[2]);
+}
+
+
+TEST(AnnealTest, TestRepeatedCalls) {
+  Lj2d pot;
+  std::vector<double> init = {0,0, 1.5,0, 0,1.5, 1.5,1.5};
+  Anneal anneal(0.1, 0.05);
+  anneal.setSeed(1).setMaxIter(20);
+  State s1 = pot.newState(init);
+  std::vector<double> result = anneal.minimise(s1);
+
+  // A second call continues the random numbers, unless the seed is set again
+  State s2 = pot.newState(init);
+  EXPECT_NE(anneal.minimise(s2), result);
+  State s3 = pot.newState(init);
+  EXPECT_EQ(anneal.setSeed(1).minimise(s3), result);
+}
+
+
+TEST(AnnealTest, TestCheckpoint) {
+  Lj2d pot;
+  std::vector<double> init = {0,0, 1.5,0, 0,1.5, 1.5,1.5};
+  Anneal full(0.1, 0.05);
+  full.setSeed(1).setMaxIter(100);
+  State s0 = pot.newState(init);
+  std::vector<double> result = full.minimise(s0);
+
+  // The chain continues from the checkpoint as if it had not been interrupted
+  std::string file = "anneal_checkpoint.bin";
+  Anneal interrupted(0.1, 0.05);
+  interrupted.setSeed(1).setMaxIter(60).setCheckpoint(file, 50);
+  State s1 = pot.newState(init);
+  interrupted.minimise(s1);
+
+  Anneal resumed(0.1, 0.05);
+  resumed.setSeed(1).setMaxIter(100);
+  State s2 = pot.newState(init);
+  EXPECT_EQ(resumed.resume(s2, file), result);
+  mpi.barrier();
+  if (mpi.rank == 0) std::remove(file.c_str());
+}
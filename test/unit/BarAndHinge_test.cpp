@@ -4,6 +4,7 @@
 #include <math.h>
 #include "State.h"
 #include "minimisers/Lbfgs.h"
+#include "utils/vec.h"
 #include "utils/mpi.h"
 #include "utils/print.h"
 
@@ -24,33 +25,50 @@ TEST(BarAndHingeTest, TestMin) {
   Lbfgs min;
 
   State s1 = initState;
-  if (mpi.rank==0) s1.pot->elements[iBend].parameters[1] = 1e-6;
+  if (mpi.rank==0) s1.pot->elements.parameters(iBend)[1] = 1e-6;
   Vector x1 = min.minimise(s1);
   double dz = sqrt(2)/2;
   Vector x1_expected = {0,0,0.5+dz, 0,-sqrt(2),0.5-dz, 0,sqrt(2),0.5-dz, 0,0,0.5+dz};
   EXPECT_TRUE(ArraysNear(x1, x1_expected, 1e-4));
 
   State s2 = initState;
-  if (mpi.rank==0) s2.pot->elements[iBend].parameters[1] = pi/2;
+  if (mpi.rank==0) s2.pot->elements.parameters(iBend)[1] = pi/2;
   Vector x2 = min.minimise(s2);
   Vector x2_expected = {-1,0,1, 0,-sqrt(2),0, 0,sqrt(2),0, 1,0,1};
   EXPECT_TRUE(ArraysNear(x2, x2_expected, 1e-4));
 
   State s3 = initState;
-  if (mpi.rank==0) s3.pot->elements[iBend].parameters[1] = pi;
+  if (mpi.rank==0) s3.pot->elements.parameters(iBend)[1] = pi;
   Vector x3 = min.minimise(s3);
   Vector x3_expected = {-sqrt(2),0,0.5, 0,-sqrt(2),0.5, 0,sqrt(2),0.5, sqrt(2),0,0.5};
   EXPECT_TRUE(ArraysNear(x3, x3_expected, 1e-4));
 
   State s4 = initState;
-  if (mpi.rank==0) s4.pot->elements[iBend].parameters[1] = 3*pi/2;
+  if (mpi.rank==0) s4.pot->elements.parameters(iBend)[1] = 3*pi/2;
   Vector x4 = min.minimise(s4);
   Vector x4_expected = {-1,0,0, 0,-sqrt(2),1, 0,sqrt(2),1, 1,0,0};
   EXPECT_TRUE(ArraysNear(x4, x4_expected, 1e-4));
 
   State s5 = initState;
-  if (mpi.rank==0) s5.pot->elements[iBend].parameters[1] = 2*pi-1e-6;
+  if (mpi.rank==0) s5.pot->elements.parameters(iBend)[1] = 2*pi-1e-6;
   Vector x5 = min.minimise(s5);
   Vector x5_expected = {0,0,0.5-dz, 0,-sqrt(2),0.5+dz, 0,sqrt(2),0.5+dz, 0,0,0.5-dz};
   EXPECT_TRUE(ArraysNear(x5, x5_expected, 1e-4));
 }
+
+
+TEST(BarAndHingeTest, TestHessianVector) {
+  BarAndHinge pot;
+  pot.setTriangulation({{0,1,2}, {1,3,2}});
+  pot.setRigidity(100, 1);
+  pot.setLength0(1.8);
+  pot.setTheta0(2);
+  pot.setWall().setWallParams(1e-3, 0.5);
+  Vector coords = {-1,0,1, 0,-sqrt(2),0.1, 0.1,sqrt(2),-0.05, 1,0.2,1.1};
+  State s = pot.newState(coords);
+
+  Vector v = {0.3,-0.2,0.1, 0.5,0.2,-0.4, -0.1,0.3,0.2, 0.2,-0.3,0.1};
+  double eps = 1e-6;
+  Vector hvFD = (s.gradient(coords + eps*v) - s.gradient(coords - eps*v)) / (2*eps);
+  EXPECT_TRUE(ArraysNear(s.hessianVector(v), hvFD, 1e-4));
+}
@@ -0,0 +1,52 @@
+#include "test_main.cpp"
+#include "minimisers/BasinHopping.h"
+
+#include "State.h"
+#include "minimisers/Lbfgs.h"
+#include "potentials/LjNd.h"
+#include "utils/vec.h"
+#include "utils/mpi.h"
+
+using namespace minim;
+
+
+TEST(BasinHoppingTest, TestFingerprint) {
+  // Invariant to permutations, translations and rotations
+  auto fp = BasinHopping::particleFingerprint(2);
+  std::vector<double> a = fp({0,0, 1,0, 0,2});
+  std::vector<double> b = fp({5,3, 5,1, 6,3});
+  EXPECT_TRUE(ArraysNear(a, b, 1e-12));
+}
+
+
+TEST(BasinHoppingTest, TestLj) {
+  Lj3d pot;
+  Lbfgs lbfgs;
+  BasinHopping bh(lbfgs, 0.8, 0.4);
+  bh.setMaxIter(30).setSeed(1).setFingerprint(BasinHopping::particleFingerprint(3));
+  EXPECT_EQ(bh.walkerRanks(), std::vector<int>({mpi.rank}));
+
+  std::vector<double> init = {0,0,0, 1.2,0,0, 0,1.2,0, 0,0,1.2, 1.2,1.2,0, 1.2,0,1.2, 0,1.2,1.2};
+  State s = pot.newState(init, bh.walkerRanks());
+  s.convergence = 1e-6;
+  bh.minimise(s);
+
+  // The global minimum of the 7 atom cluster (pentagonal bipyramid) is found and shared by all walkers
+  EXPECT_NEAR(bh.bestEnergy, -16.505384, 1e-5);
+  EXPECT_NEAR(s.energy(), bh.bestEnergy, 1e-10);
+  std::vector<double> coords = s.coords();
+  std::vector<double> coords0 = coords;
+  mpi.bcast(coords0);
+  EXPECT_TRUE(ArraysNear(coords, coords0, 1e-12));
+
+  // The database only holds distinct minima
+  EXPECT_EQ(bh.nQuench, 32); // The initial state and each iteration
+  EXPECT_GT(bh.nDuplicate, 0);
+  EXPECT_EQ((int)bh.minima().size(), bh.nQuench - bh.nDuplicate);
+  for (size_t i=0; i<bh.minima().size(); i++) {
+    for (size_t j=0; j<i; j++) {
+      EXPECT_FALSE(fabs(bh.minima()[i].energy - bh.minima()[j].energy) < 1e-8 &&
+                   ArraysNear(bh.minima()[i].fingerprint, bh.minima()[j].fingerprint, 1e-4));
+    }
+  }
+}
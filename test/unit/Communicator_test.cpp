@@ -3,6 +3,7 @@
 #include "communicators/CommUnstructured.h"
 #include "communicators/CommGrid.h"
 
+#include <cstdio>
 #include "Potential.h"
 #include "State.h"
 #include "utils/vec.h"
@@ -258,3 +259,62 @@ TEST(CommGrid, TestDotProduct) {
                       1,  1,  1,  1, 1};
   EXPECT_EQ(comm.dotProduct(a, b), 4*1200);
 }
+
+
+TEST(CommGrid, TestReduction) {
+  CommGrid comm(1);
+  comm.commArray = {2, 2};
+  GridPot pot({4,6});
+  comm.setup(pot, 24, {});
+
+  vector<double> a = {1,  1,  1,  1, 1,
+                      1, 10, 10, 10, 1,
+                      1, 20, 20, 20, 1,
+                      1,  1,  1,  1, 1};
+  Reduction sums(comm);
+  int iRank = sums.add(comm.rank());
+  int iOne = sums.add(1);
+  int iDot = sums.addDot(a, a);
+  sums.start();
+  EXPECT_THROW(sums.add(0), std::logic_error);
+  sums.wait();
+  EXPECT_EQ(sums.size(), 3u);
+  EXPECT_EQ(sums[iRank], 6);
+  EXPECT_EQ(sums[iOne], 4);
+  EXPECT_EQ(sums[iDot], 4*1500);
+
+  // Reuse with the blocking reduction
+  sums.clear();
+  iOne = sums.add(1);
+  sums.reduce();
+  EXPECT_EQ(sums[iOne], 4);
+}
+
+
+TEST(CommGrid, TestWriteFile) {
+  CommGrid comm(1);
+  comm.commArray = {2, 2};
+  GridPot pot({4,6});
+  comm.setup(pot, 24, {});
+
+  // Different amounts of data on each processor
+  std::string file = "comm_test_file.bin";
+  vector<char> header = {'m', 'i', 'n'};
+  vector<char> local(comm.rank()+1, 'a'+comm.rank());
+  comm.writeFile(file, header, local);
+
+  vector<char> headerIn;
+  vector<char> localIn = comm.readFile(file, headerIn);
+  EXPECT_EQ(headerIn, header);
+  EXPECT_EQ(localIn, local);
+
+  // Only readable on the same number of processors
+  CommGrid comm2(1);
+  comm2.commArray = {2, 1};
+  comm2.setup(pot, 24, {0, 1});
+  if (comm2.usesThisProc) {
+    EXPECT_THROW(comm2.readFile(file, headerIn), std::invalid_argument);
+  }
+  mpi.barrier();
+  if (mpi.rank == 0) std::remove(file.c_str());
+}
@@ -0,0 +1,58 @@
+#include "test_main.cpp"
+#include "minimisers/ConjugateGradient.h"
+
+#include "State.h"
+#include "Potential.h"
+#include "potentials/LjNd.h"
+#include "utils/vec.h"
+
+using namespace minim;
+typedef std::vector<double> Vector;
+
+
+TEST(ConjugateGradientTest, TestSetMethod) {
+  ConjugateGradient min;
+  EXPECT_EQ(min.linesearch, "wolfe");
+  EXPECT_NO_THROW(min.setMethod("pr+"));
+  EXPECT_THROW(min.setMethod("fr"), std::invalid_argument);
+}
+
+
+TEST(ConjugateGradientTest, TestQuadratic) {
+  // CG with exact line searches converges in n iterations for a quadratic
+  Potential pot([](const Vector& x, double* e, Vector* g){
+    if (e) *e = 0.5 * (x[0]*x[0] + 10*x[1]*x[1]);
+    if (g) *g = {x[0], 10*x[1]};
+  });
+  State s = pot.newState({1, 1});
+  ConjugateGradient min;
+  Vector x = min.minimise(s);
+  EXPECT_TRUE(ArraysNear(x, {0, 0}, 1e-4));
+}
+
+
+TEST(ConjugateGradientTest, TestLj) {
+  for (std::string method : {"hz", "pr+"}) {
+    Lj3d pot;
+    State s = pot.newState({0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3});
+    ConjugateGradient min;
+    min.setMethod(method).minimise(s);
+    EXPECT_NEAR(s.energy(), -6, 1e-6) << method;
+    EXPECT_LT(min.iter, 100) << method;
+  }
+}
+
+
+TEST(ConjugateGradientTest, TestPipelined) {
+  // The direction reduction is overlapped with the linesearch reduction, without changing the iterations
+  Lj3d pot;
+  Vector init = {0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3};
+  State s = pot.newState(init);
+  ConjugateGradient min;
+  min.minimise(s);
+  State s2 = pot.newState(init);
+  ConjugateGradient min2;
+  min2.setPipelined(true).minimise(s2);
+  EXPECT_EQ(min2.iter, min.iter);
+  EXPECT_EQ(s2.coords(), s.coords());
+}
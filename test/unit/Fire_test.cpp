@@ -2,6 +2,7 @@
 #include "minimisers/Fire.h"
 
 #include <math.h>
+#include <cstdio>
 #include "State.h"
 #include "Potential.h"
 #include "utils/vec.h"
@@ -65,3 +66,55 @@ TEST(FireTest, TestSingleProc) {
     EXPECT_TRUE(result.empty());
   }
 }
+
+
+TEST(FireTest, TestFire2Step) {
+  Vector coords = {1, 4};
+  Vector g = {2, 8};
+
+  Toy2d pot;
+  State state = pot.newState(coords);
+  Fire min = Fire().setMethod("fire2");
+  min.setMaxIter(0);
+  min.minimise(state);
+
+  // The first step is a semi-implicit Euler step from rest, x += dt^2 F
+  double dt = 0.1 / pow(68, 0.25);
+  Vector step = -dt * dt * g;
+  EXPECT_TRUE(ArraysNear(state.coords(), coords+step, 1e-12));
+}
+
+
+TEST(FireTest, TestFire2Convergence) {
+  Toy2d pot;
+  State state = pot.newState({1, 4});
+  state.convergence = 2e-6/sqrt(2); // Designed to make a radius of convergence of 1e-6
+
+  Fire min = Fire().setMethod("fire2");
+  min.minimise(state);
+
+  EXPECT_LT(vec::norm(state.coords()), 1e-6);
+  EXPECT_LT(min.iter, min.maxIter);
+}
+
+
+TEST(FireTest, TestCheckpoint) {
+  Toy2d pot;
+  Fire full = Fire().setMaxIter(40);
+  State s0 = pot.newState({1, 4});
+  Vector result = full.minimise(s0);
+
+  // Write a checkpoint every iteration using the wall time, then continue from the last one
+  std::string file = "fire_checkpoint.bin";
+  Fire interrupted = Fire().setMaxIter(20);
+  interrupted.setCheckpoint(file, 0, 1e-9);
+  State s1 = pot.newState({1, 4});
+  interrupted.minimise(s1);
+
+  Fire resumed = Fire().setMaxIter(40);
+  State s2 = pot.newState({1, 4});
+  EXPECT_EQ(resumed.resume(s2, file), result);
+  EXPECT_EQ(resumed.iter, full.iter);
+  mpi.barrier();
+  if (mpi.rank == 0) std::remove(file.c_str());
+}
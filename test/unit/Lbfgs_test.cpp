@@ -1,5 +1,15 @@
 #include "test_main.cpp"
 #include "minimisers/Lbfgs.h"
+#include "minimisers/Fire.h"
+#include "State.h"
+#include "Potential.h"
+#include "potentials/LjNd.h"
+#include "utils/AsyncLog.h"
+#include "utils/mpi.h"
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
 
 using namespace minim;
 
@@ -8,3 +18,143 @@ TEST(LbfgsTest, TestMaxIter) {
   minim::Lbfgs lbfgs = minim::Lbfgs().setMaxIter(10);
   EXPECT_EQ(lbfgs.maxIter, 10);
 }
+
+
+TEST(LbfgsTest, TestStats) {
+  Potential pot([](const std::vector<double>& x, double* e, std::vector<double>* g){
+    if (e) *e = x[0]*x[0] + x[1]*x[1];
+    if (g) *g = {2*x[0], 2*x[1]};
+  });
+  State s = pot.newState({1, 2});
+  s.stats.enabled = true;
+  Lbfgs min;
+  min.setMaxIter(5).minimise(s);
+  EXPECT_EQ(min.stats.nCalls[Stats::ITERATION], min.iter+1);
+  EXPECT_GT(min.stats.nGradient, 0);
+  EXPECT_EQ(min.stats.nCalls[Stats::LINESEARCH], min.iter+1);
+  EXPECT_EQ(s.stats.nCalls[Stats::ITERATION], min.iter+1);
+}
+
+
+double shift = 0;
+TEST(LbfgsTest, TestAdjustPotential) {
+  Potential pot([](const std::vector<double>& x, double* e, std::vector<double>* g){
+    if (e) *e = x[0]*x[0] + shift;
+    if (g) *g = {2*x[0]};
+  });
+  State s = pot.newState({1});
+  s.energy(); // Cached before the potential is changed
+
+  // The first step is accepted if the linesearch uses the energy of the changed potential
+  Lbfgs min;
+  min.setMaxIter(0).minimise(s, [](int iter, State& s) { shift = 10; });
+  EXPECT_FLOAT_EQ(min.progress.energy, s.energy());
+  EXPECT_LT(fabs(s.coords()[0]), 0.5);
+  shift = 0;
+}
+
+
+TEST(LbfgsTest, TestSingleReduction) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3});
+  s.stats.enabled = true;
+  Lbfgs min;
+  min.setMaxStep(0.1).setLinesearch("none");
+  min.setMaxIter(1000).minimise(s);
+  EXPECT_NEAR(s.energy(), -6, 1e-6);
+  if (s.comm->size() > 1) {
+    // One reduction for the initial gradient norm, then one per iteration
+    EXPECT_EQ(min.stats.nCalls[Stats::REDUCE], min.iter+2);
+  }
+}
+
+
+TEST(LbfgsTest, TestWolfeLinesearch) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3});
+  s.stats.enabled = true;
+  Lbfgs min;
+  min.setLinesearch("wolfe");
+  min.setMaxIter(1000).minimise(s);
+  EXPECT_NEAR(s.energy(), -6, 1e-6);
+  // Each trial evaluates the energy and gradient together, and the accepted gradient is not recomputed
+  EXPECT_EQ(min.stats.nEnergy, min.stats.nGradient);
+}
+
+
+TEST(LbfgsTest, TestPipelined) {
+  // The history reduction is overlapped with the linesearch reduction, without changing the iterations
+  Lj3d pot;
+  vector<double> init = {0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3};
+  State s = pot.newState(init);
+  Lbfgs min;
+  min.setLinesearch("wolfe");
+  min.setMaxIter(1000).minimise(s);
+  State s2 = pot.newState(init);
+  Lbfgs min2;
+  min2.setLinesearch("wolfe");
+  min2.setPipelined(true).setMaxIter(1000).minimise(s2);
+  EXPECT_EQ(min2.iter, min.iter);
+  EXPECT_EQ(s2.coords(), s.coords());
+}
+
+
+TEST(LbfgsTest, TestLog) {
+  // Logging uses the values found by the minimiser, so it does not add any evaluations
+  Lj3d pot;
+  std::vector<double> init = {0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3};
+  State s0 = pot.newState(init);
+  s0.stats.enabled = true;
+  Lbfgs min;
+  min.setMaxIter(20).minimise(s0);
+  Stats stats = min.stats;
+
+  std::ostringstream out;
+  AsyncLog log(out);
+  State s = pot.newState(init);
+  s.stats.enabled = true;
+  min.setLogSink(log).minimise(s, "egd-1");
+  log.flush();
+  EXPECT_EQ(min.stats.nEnergy, stats.nEnergy);
+  EXPECT_EQ(min.stats.nGradient, stats.nGradient);
+  EXPECT_EQ(min.stats.nCalls[Stats::GATHER], 0);
+
+  // One line per iteration, with the final energy matching the state
+  if (mpi.rank == 0) {
+    std::istringstream lines(out.str());
+    std::string line, last;
+    int nLines = 0;
+    while (std::getline(lines, line)) {
+      last = line;
+      nLines++;
+    }
+    EXPECT_EQ(nLines, std::min(min.iter, min.maxIter)+1);
+    EXPECT_NE(last.find("D: "), std::string::npos);
+  }
+}
+
+
+TEST(LbfgsTest, TestCheckpoint) {
+  Lj3d pot;
+  std::vector<double> init = {0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3};
+  State s0 = pot.newState(init);
+  Lbfgs full;
+  std::vector<double> result = full.minimise(s0);
+
+  // Stop after 15 iterations, having written a checkpoint after 10, and continue from it with a new minimiser
+  std::string file = "lbfgs_checkpoint.bin";
+  State s1 = pot.newState(init);
+  Lbfgs interrupted;
+  interrupted.setCheckpoint(file, 10).setMaxIter(14).minimise(s1);
+  ASSERT_GT(full.iter, 15);
+
+  State s2 = pot.newState(init);
+  Lbfgs resumed;
+  EXPECT_EQ(resumed.resume(s2, file), result);
+  EXPECT_EQ(resumed.iter, full.iter);
+
+  // Only the same minimiser can continue from the checkpoint
+  EXPECT_THROW(Fire().resume(s2, file), std::invalid_argument);
+  mpi.barrier();
+  if (mpi.rank == 0) std::remove(file.c_str());
+}
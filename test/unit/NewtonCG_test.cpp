@@ -0,0 +1,55 @@
+#include "test_main.cpp"
+#include "minimisers/NewtonCG.h"
+
+#include "State.h"
+#include "Potential.h"
+#include "potentials/LjNd.h"
+#include "utils/vec.h"
+
+using namespace minim;
+typedef std::vector<double> Vector;
+
+
+TEST(NewtonCGTest, TestIllConditioned) {
+  // Quadratic with a condition number of 1e6, using the finite difference Hessian
+  Potential pot([](const Vector& x, double* e, Vector* g){
+    if (e) *e = 0.5 * (x[0]*x[0] + 1e6*x[1]*x[1]);
+    if (g) *g = {x[0], 1e6*x[1]};
+  });
+  State s = pot.newState({1, 1});
+  NewtonCG min;
+  Vector x = min.minimise(s);
+  EXPECT_TRUE(ArraysNear(x, {0, 0}, 1e-6));
+  EXPECT_LT(min.iter, 5);
+}
+
+
+TEST(NewtonCGTest, TestLj) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3});
+  NewtonCG min;
+  min.minimise(s);
+  EXPECT_NEAR(s.energy(), -6, 1e-6);
+  EXPECT_LT(min.iter, 50);
+}
+
+
+TEST(NewtonCGTest, TestPipelined) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3});
+  NewtonCG min;
+  min.setPipelined(true).minimise(s);
+  EXPECT_NEAR(s.energy(), -6, 1e-6);
+  EXPECT_LT(min.iter, 50);
+
+  // Ill-conditioned quadratic, using the finite difference Hessian
+  Potential quad([](const Vector& x, double* e, Vector* g){
+    if (e) *e = 0.5 * (x[0]*x[0] + 1e6*x[1]*x[1]);
+    if (g) *g = {x[0], 1e6*x[1]};
+  });
+  State s2 = quad.newState({1, 1});
+  NewtonCG min2;
+  Vector x = min2.setPipelined(true).minimise(s2);
+  EXPECT_TRUE(ArraysNear(x, {0, 0}, 1e-6));
+  EXPECT_LT(min2.iter, 5);
+}
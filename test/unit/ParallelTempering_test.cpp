@@ -0,0 +1,41 @@
+#include "test_main.cpp"
+#include "minimisers/ParallelTempering.h"
+
+#include "State.h"
+#include "potentials/LjNd.h"
+#include "utils/vec.h"
+#include "utils/mpi.h"
+
+using namespace minim;
+
+
+TEST(ParallelTemperingTest, TestReplicas) {
+  ParallelTempering pt(0.1, 1, 0.1);
+  EXPECT_EQ(pt.nReplica(), mpi.size);
+  EXPECT_EQ(pt.replica(), mpi.rank);
+  EXPECT_EQ(pt.replicaRanks(), std::vector<int>({mpi.rank}));
+  EXPECT_FLOAT_EQ(pt.temperatures.front(), 0.1);
+  EXPECT_FLOAT_EQ(pt.temperatures.back(), (mpi.size > 1) ? 1 : 0.1);
+}
+
+
+TEST(ParallelTemperingTest, TestLj) {
+  ParallelTempering pt(0.05, 0.5, 0.05);
+  pt.setMaxIter(2000).setSeed(1);
+  Lj2d pot;
+  std::vector<double> init = {0,0, 1.5,0, 0,1.5, 1.5,1.5, 3,0, 3,1.5, 0,3};
+  State s = pot.newState(init, pt.replicaRanks());
+  double e0 = s.energy();
+  pt.minimise(s);
+
+  // All replicas finish with the lowest energy configuration
+  EXPECT_LT(pt.bestEnergy, e0);
+  EXPECT_NEAR(s.energy(), pt.bestEnergy, 1e-10);
+  std::vector<double> coords = s.coords();
+  std::vector<double> coords0 = coords;
+  mpi.bcast(coords0);
+  EXPECT_TRUE(ArraysNear(coords, coords0, 1e-12));
+  if (mpi.size > 1) {
+    EXPECT_GT(pt.nExchangeAttempt, 0);
+  }
+}
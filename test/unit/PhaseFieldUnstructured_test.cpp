@@ -81,9 +81,7 @@ TEST(PhaseFieldUnstructuredTest, TestExternalForce) {
 
   // Test force with non-constant phi
   auto stateForce1 = pot.setGridSize({2,2,2}).setForce({-4,0,0}).newState({-1,-1,-1,-1, 1,1,1,1});
-  for (auto el=stateForce1.pot->elements.begin(); el!=stateForce1.pot->elements.end(); el++) {
-    if (el->type==0) stateForce1.pot->elements.erase(el); // Remove the bulk fluid energy elements
-  }
+  stateForce1.pot->elements.eraseIf([](const Element& el){ return el.type==0; }); // Remove the bulk fluid energy elements
   EXPECT_FLOAT_EQ(stateForce1.energy(), 8);
   EXPECT_TRUE(ArraysNear(stateForce1.gradient(), {0,0,0,0, 1,1,1,1}, 1e-6));
 }
@@ -93,9 +91,7 @@ TEST(PhaseFieldUnstructuredTest, TestSurfaceEnergy) {
   PhaseFieldUnstructured pot;
   pot.setGridSize({2,1,1}).setContactAngle({90,60}).setSolid({1,0});
   auto state = pot.newState({0.0, 0.5});
-  for (auto el=state.pot->elements.begin(); el!=state.pot->elements.end(); el++) {
-    if (el->type==0) state.pot->elements.erase(el); // Remove the bulk fluid energy elements
-  }
+  state.pot->elements.eraseIf([](const Element& el){ return el.type==0; }); // Remove the bulk fluid energy elements
   EXPECT_FLOAT_EQ(state.energy(), 0.5/sqrt(2.0)*(-27.0/24));
   EXPECT_TRUE(ArraysNear(state.gradient(), {0, 0.5/sqrt(2.0)*(-0.75)}, 1e-6));
 }
@@ -148,9 +144,7 @@ TEST(PhaseFieldUnstructuredTest, TestResolution) {
   // External Force
   pot.setGridSize({2,2,2}).setSolid({0,0,0,0,0,0,0,0}).setForce({-4,0,0});
   auto s2 = pot.newState({-1,-1,-1,-1, 1,1,1,1});
-  for (auto el=s2.pot->elements.begin(); el!=s2.pot->elements.end(); el++) {
-    if (el->type==0) s2.pot->elements.erase(el); // Remove the bulk fluid energy elements
-  }
+  s2.pot->elements.eraseIf([](const Element& el){ return el.type==0; }); // Remove the bulk fluid energy elements
   EXPECT_FLOAT_EQ(s2.energy(), 128);
   EXPECT_TRUE(ArraysNear(s2.gradient(), {0,0,0,0, 16,16,16,16}, 1e-6));
   pot.setForce({0,0,0});
@@ -158,9 +152,7 @@ TEST(PhaseFieldUnstructuredTest, TestResolution) {
   // Surface energy
   pot.setGridSize({2,1,1}).setSolid({1,0}).setContactAngle({90,60});
   auto s3 = pot.newState({0, 0.5});
-  for (auto el=s3.pot->elements.begin(); el!=s3.pot->elements.end(); el++) {
-    if (el->type==0) s3.pot->elements.erase(el); // Remove the bulk fluid energy elements
-  }
+  s3.pot->elements.eraseIf([](const Element& el){ return el.type==0; }); // Remove the bulk fluid energy elements
   EXPECT_FLOAT_EQ(s3.energy(), 0.5/sqrt(2.0)*(-27.0/24)*4);
   EXPECT_TRUE(ArraysNear(s3.gradient(), {0, 0.5/sqrt(2.0)*(-0.75)*4}, 1e-6));
 
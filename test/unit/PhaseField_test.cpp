@@ -3,6 +3,7 @@
 
 #include "State.h"
 #include "communicators/CommGrid.h"
+#include "minimisers/Lbfgs.h"
 #include "utils/vec.h"
 
 using namespace minim;
@@ -199,3 +200,144 @@ TEST(PhaseFieldTest, TestFixFluid) {
     EXPECT_FLOAT_EQ(g[3*iGrid], 0);
   }
 }
+
+TEST(PhaseFieldTest, TestThreads) {
+#ifndef _OPENMP
+  GTEST_SKIP() << "Build with openmp=1 to test threading";
+#endif
+  PhaseField pot;
+  pot.setGridSize({12,4,3}).setSolid([](int x, int y, int z){ return (x==5 && y==0); });
+  vector<double> coords(12*4*3);
+  for (int i=0; i<(int)coords.size(); i++) coords[i] = sin(0.7*i);
+
+  // Single processor (periodic in x) and distributed
+  for (vector<int> ranks : vector<vector<int>>{{0}, {}}) {
+    State s1 = pot.setThreads(1).newState(coords, ranks);
+    State s4 = pot.setThreads(4).newState(coords, ranks);
+    EXPECT_EQ(s1.allEnergy(), s4.allEnergy());
+    EXPECT_TRUE(ArraysMatch(s1.allGradient(), s4.allGradient()));
+  }
+}
+
+TEST(PhaseFieldTest, TestBatch) {
+  PhaseField pot;
+  pot.setGridSize({4,4,1}).setSolid([](int x, int y, int z){ return (x==0 && y==0); }).setContactAngle(60);
+  State s = pot.newState(vector<double>(16, 0));
+  vector<vector<double>> coords(3, s.blockCoords());
+  for (int k=0; k<3; k++) {
+    for (int i=0; i<(int)coords[k].size(); i++) coords[k][i] = sin(0.7*i + k);
+  }
+
+  vector<double> e;
+  vector<vector<double>> g;
+  s.batchEnergyGradient(coords, &e, &g);
+  for (int k=0; k<3; k++) {
+    s.blockCoords(coords[k]);
+    EXPECT_FLOAT_EQ(e[k], s.energy());
+    EXPECT_TRUE(ArraysNear(g[k], s.procGradient(), 1e-10));
+  }
+}
+
+
+TEST(PhaseFieldTest, TestHessianVector) {
+  PhaseField pot;
+  pot.setGridSize({4,4,1}).setSolid([](int x, int y, int z){ return (x==0 && y==0); }).setContactAngle(60);
+  State s = pot.newState(vector<double>(16, 0));
+  vector<double> coords = s.blockCoords();
+  vector<double> v = s.blockCoords();
+  for (int i=0; i<(int)coords.size(); i++) {
+    coords[i] = sin(0.7*i);
+    v[i] = cos(1.3*i);
+  }
+  s.blockCoords(coords);
+
+  double eps = 1e-6;
+  vector<double> hv;
+  s.procHessianVector(v, &hv);
+  vector<double> hvFD = (s.procGradient(coords + eps*v) - s.procGradient(coords - eps*v)) / (2*eps);
+  EXPECT_TRUE(ArraysNear(hv, hvFD, 1e-4));
+}
+
+
+TEST(PhaseFieldTest, TestPreconditioner) {
+  PhaseField pot;
+  pot.setGridSize({16,16,1}).setSolid([](int x, int y, int z){ return (x==0 && y<4); });
+  vector<double> init(256);
+  for (int i=0; i<256; i++) init[i] = ((i/16-8)*(i/16-8) + (i%16-8)*(i%16-8) < 25) ? 1 : -1;
+  State s = pot.newState(init);
+  ASSERT_TRUE(s.pot->hasPreconditioner());
+
+  // The preconditioner is symmetric positive definite
+  vector<double> u = s.blockCoords();
+  vector<double> v = s.blockCoords();
+  for (int i=0; i<(int)u.size(); i++) {
+    u[i] = sin(0.7*i);
+    v[i] = cos(1.3*i);
+  }
+  s.comm->communicate(u);
+  s.comm->communicate(v);
+  vector<double> mu, mv;
+  s.procPrecondition(u, &mu);
+  s.procPrecondition(v, &mv);
+  EXPECT_NEAR(s.comm->dotProduct(u, mv), s.comm->dotProduct(v, mu), 1e-10);
+  EXPECT_GT(s.comm->dotProduct(u, mu), 0);
+
+  // Preconditioning reduces the number of iterations
+  State s2 = s;
+  Lbfgs min;
+  min.minimise(s);
+  int iterBasic = min.iter;
+  min.setPrecondition(true);
+  min.minimise(s2);
+  EXPECT_LT(min.iter, iterBasic);
+  EXPECT_NEAR(s.energy(), s2.energy(), 1e-6);
+
+  // The preconditioner can be enabled after the state is created
+  State s3 = pot.setPreconditionerSweeps(0).newState(init);
+  EXPECT_FALSE(s3.pot->hasPreconditioner());
+  static_cast<PhaseField&>(*s3.pot).setPreconditionerSweeps(4);
+  vector<double> mu3;
+  s3.procPrecondition(u, &mu3);
+  EXPECT_TRUE(ArraysNear(mu3, mu, 1e-12));
+}
+
+
+TEST(PhaseFieldTest, TestCoarsen) {
+  PhaseField pot;
+  pot.setGridSize({8,8,1}).setResolution(0.5).setSolid([](int x, int y, int z){ return (x==1); });
+  PhaseField coarse = pot.coarsen();
+  EXPECT_EQ(coarse.gridSize, vector<int>({4,4,1}));
+  EXPECT_FLOAT_EQ(coarse.resolution, 1);
+  EXPECT_EQ(coarse.interfaceSize, vector<double>({0.5}));
+  for (int i=0; i<16; i++) EXPECT_EQ(coarse.solid[i], (i/4 == 0)); // The solid layer is kept
+
+  // Restriction and prolongation
+  vector<double> fine(64);
+  for (int i=0; i<64; i++) fine[i] = i/8;
+  vector<double> restricted = pot.restrictCoords(fine);
+  for (int i=0; i<16; i++) EXPECT_FLOAT_EQ(restricted[i], 2*(i/4) + 0.5);
+  vector<double> prolonged = pot.prolongCoords(vector<double>(16, 2));
+  EXPECT_TRUE(ArraysNear(prolonged, vector<double>(64, 2), 1e-12));
+}
+
+
+TEST(PhaseFieldTest, TestMultilevel) {
+  // Stripe with a long wavelength perturbation of the interfaces
+  int n = 32;
+  PhaseField pot;
+  pot.setGridSize({n,n,1}).setResolution(2).setInterfaceSize(2);
+  vector<double> init(n*n);
+  for (int i=0; i<n*n; i++) {
+    double shift = n/8.0 * sin(2*3.1415926536*(i%n)/n);
+    init[i] = (i/n > n/4+shift && i/n < 3*n/4+shift) ? 1 : -1;
+  }
+
+  State s = pot.newState(init);
+  Lbfgs min;
+  min.minimise(s);
+  int iterDirect = min.iter;
+  State s2 = pot.multilevelMinimise(init, min);
+  EXPECT_LT(min.iter, iterDirect);
+  EXPECT_EQ(s2.ndof, n*n);
+  EXPECT_NEAR(s2.energy(), s.energy(), 1e-3*s.energy());
+}
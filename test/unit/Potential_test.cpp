@@ -2,6 +2,7 @@
 #include "Potential.h"
 
 #include "State.h"
+#include "potentials/FunctionPotential.h"
 #include "utils/vec.h"
 
 using namespace minim;
@@ -61,3 +62,50 @@ TEST(PotentialTest, TestConstraints) {
   EXPECT_FALSE(pot.isFixed(0));
   EXPECT_TRUE(ArraysMatch(pot.isFixed({0,1}), {false,true}));
 }
+
+
+TEST(PotentialTest, TestElementTable) {
+  auto efunc = [](const vector<double>& x){ return vec::dotProduct(x, x); };
+  auto gfunc = [](const vector<double>& x){ return 2*x; };
+  Potential pot(efunc, gfunc);
+  pot.setElements({{0, {0,1}, {1.5}}, {1, {1,2,3}}, {0, {3,4}, {2.5}}});
+  EXPECT_EQ(pot.elements.size(), 3);
+  EXPECT_TRUE(ArraysMatch(pot.elements.idofs, {0,1, 1,2,3, 3,4}));
+  EXPECT_TRUE(ArraysMatch(pot.elements.params, {1.5, 2.5}));
+  EXPECT_EQ(pot.elements[1].type, 1);
+  EXPECT_EQ(pot.elements[1].idof.size(), 3);
+  EXPECT_TRUE(pot.elements[1].parameters.empty());
+  EXPECT_EQ(pot.elements[2].idof[1], 4);
+
+  // Parameters can be modified in place
+  pot.elements.parameters(2)[0] = 3.5;
+  EXPECT_FLOAT_EQ(pot.elements[2].parameters[0], 3.5);
+
+  // Erasing preserves the order of the remaining elements
+  pot.elements.eraseIf([](const Element& el){ return el.type==0; });
+  EXPECT_EQ(pot.elements.size(), 1);
+  EXPECT_TRUE(ArraysMatch(pot.elements.idofs, {1,2,3}));
+  EXPECT_TRUE(pot.elements.params.empty());
+}
+
+
+TEST(PotentialTest, TestFunctionPotential) {
+  // Fused energy and gradient with captured parameters
+  double k = 2;
+  auto pot = makePotential([k](const vector<double>& x, double* e, vector<double>* g){
+    if (e) *e = k * vec::dotProduct(x, x);
+    if (g) *g = 2*k*x;
+  });
+  State s = pot.newState({1, 2});
+  EXPECT_FLOAT_EQ(s.energy(), 10);
+  EXPECT_TRUE(ArraysMatch(s.gradient(), {4,8}));
+  EXPECT_FLOAT_EQ(pot.energy({1, 1}), 4);
+
+  // Separate energy and gradient
+  auto pot2 = makePotential([k](const vector<double>& x){ return k * vec::dotProduct(x, x); },
+                            [k](const vector<double>& x){ return 2*k*x; });
+  pot2.setConstraints({1});
+  State s2 = pot2.newState({1, 2});
+  EXPECT_FLOAT_EQ(s2.energy(), 10);
+  EXPECT_TRUE(ArraysMatch(s2.gradient(), {4,0}));
+}
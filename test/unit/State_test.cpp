@@ -3,6 +3,7 @@
 
 #include "potentials/LjNd.h"
 #include "communicators/CommUnstructured.h"
+#include "utils/vec.h"
 #include "utils/mpi.h"
 
 using namespace minim;
@@ -130,3 +131,158 @@ TEST(StateTest, TestAllEnergy) {
   EXPECT_TRUE(ArraysNear(g1, {-93./512,0,0, 93./512,0,0}, 1e-6));
   EXPECT_TRUE(ArraysNear(g2, {-93./512,0,0, 93./512,0,0}, 1e-6));
 }
+
+
+TEST(StateTest, TestInPlaceGradient) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 2,0,0});
+  Vector g(6, 1);
+  const double* gData = g.data();
+  s.procEnergyGradient(nullptr, &g);
+  Vector gProc = (mpi.rank==0) ? Vector({-93./512,0,0, 93./512,0,0}) : Vector();
+  EXPECT_TRUE(ArraysNear(g, gProc, 1e-6));
+  EXPECT_EQ(g.data(), gData); // The storage of g is reused
+
+  Vector coords = {0,0,0, 3,0,0};
+  s.coords(std::move(coords));
+  EXPECT_TRUE(ArraysMatch(s.coords(), {0,0,0, 3,0,0}));
+}
+
+
+TEST(StateTest, TestThreadedElements) {
+#ifndef _OPENMP
+  GTEST_SKIP() << "Build with openmp=1 to test threading";
+#endif
+  // Enough atoms for the elements to span several blocks
+  Vector coords;
+  for (int i=0; i<40; i++) coords.insert(coords.end(), {1.1*(i%4), 1.1*((i/4)%5), 1.1*(i/20)});
+  Lj3d pot;
+  State s1 = pot.newState(coords);
+  State s4 = pot.setThreads(4).newState(coords);
+  double e1, e4;
+  Vector g1, g4;
+  s1.energyGradient(&e1, &g1);
+  s4.energyGradient(&e4, &g4);
+  EXPECT_EQ(e1, e4); // The energy should be identical for any number of threads
+  EXPECT_TRUE(ArraysNear(g1, g4, 1e-10));
+}
+
+
+int nEvaluations = 0;
+TEST(StateTest, TestEvaluationCache) {
+  Potential pot([](const Vector& x, double* e, Vector* g){
+    nEvaluations++;
+    if (e) *e = vec::dotProduct(x, x);
+    if (g) *g = 2*x;
+  });
+  State s = pot.newState({1, 2});
+  s.cacheGradient = true;
+
+  // Repeated evaluations at the same coordinates are reused
+  nEvaluations = 0;
+  double e;
+  Vector g;
+  s.energyGradient(&e, &g);
+  EXPECT_FLOAT_EQ(s.energy(), 5);
+  EXPECT_TRUE(ArraysMatch(s.gradient(), {2,4}));
+  s.procEnergyGradient(&e, &g);
+  EXPECT_EQ(nEvaluations, 1);
+
+  // Changing the coordinates invalidates the cache
+  s.coords({1, 1});
+  EXPECT_FLOAT_EQ(s.energy(), 2);
+  EXPECT_EQ(nEvaluations, 2);
+  EXPECT_TRUE(ArraysMatch(s.gradient(), {2,2}));
+  EXPECT_EQ(nEvaluations, 3);
+  s.blockCoords(s.blockCoords());
+  EXPECT_FLOAT_EQ(s.energy(), 2);
+  EXPECT_EQ(nEvaluations, 4);
+  s.clearCache();
+  EXPECT_FLOAT_EQ(s.energy(), 2);
+  EXPECT_EQ(nEvaluations, 5);
+
+  // By default only the energy is kept
+  s.cacheGradient = false;
+  s.coords({1, 2});
+  s.energyGradient(&e, &g);
+  EXPECT_FLOAT_EQ(s.energy(), 5);
+  EXPECT_EQ(nEvaluations, 6);
+  EXPECT_TRUE(ArraysMatch(s.gradient(), {2,4}));
+  EXPECT_EQ(nEvaluations, 7);
+}
+
+
+TEST(StateTest, TestBatchEnergyGradient) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 2,0,0, 0,2,0, 0,0,2});
+  vector<Vector> coords = {s.blockCoords(), 1.1*s.blockCoords(), 0.9*s.blockCoords()};
+
+  Vector e;
+  vector<Vector> g;
+  s.batchEnergyGradient(coords, &e, &g);
+  ASSERT_EQ(e.size(), 3);
+  ASSERT_EQ(g.size(), 3);
+  for (int k=0; k<3; k++) {
+    s.blockCoords(coords[k]);
+    EXPECT_FLOAT_EQ(e[k], s.energy());
+    EXPECT_TRUE(ArraysNear(g[k], s.procGradient(), 1e-10));
+  }
+  EXPECT_TRUE(ArraysNear(s.batchEnergy(coords), e, 1e-10));
+}
+
+
+TEST(StateTest, TestStats) {
+  Lj3d pot;
+  State s = pot.newState({0,0,0, 2,0,0, 0,2,0, 0,0,2});
+
+  // Nothing is recorded unless enabled
+  s.energy();
+  EXPECT_EQ(s.stats.nEnergy, 0);
+  EXPECT_EQ(s.stats.nCalls[Stats::POTENTIAL], 0);
+
+  s.stats.enabled = true;
+  s.blockCoords(s.blockCoords());
+  double e;
+  Vector g;
+  s.energyGradient(&e, &g);
+  s.energy(); // Cached
+  EXPECT_EQ(s.stats.nEnergy, 1);
+  EXPECT_EQ(s.stats.nGradient, 1);
+  EXPECT_EQ(s.stats.nCalls[Stats::POTENTIAL], 1);
+  EXPECT_EQ(s.stats.nCalls[Stats::CONSTRAINTS], 1);
+  if (s.comm->size() > 1) {
+    EXPECT_EQ(s.stats.nCalls[Stats::ACCUMULATE], 1);
+    EXPECT_EQ(s.stats.nCalls[Stats::HALO], 1);
+    EXPECT_EQ(s.stats.nCalls[Stats::REDUCE], 2);
+    EXPECT_GT(s.stats.bytes, 0);
+  }
+  EXPECT_GE(s.stats.time[Stats::POTENTIAL], 0);
+
+  // Copies record into their own stats
+  State sCopy = s;
+  sCopy.gradient({0,0,0, 1,0,0, 0,1,0, 0,0,1});
+  EXPECT_EQ(sCopy.stats.nGradient, 2);
+  EXPECT_EQ(s.stats.nGradient, 1);
+
+  s.stats.reset();
+  EXPECT_EQ(s.stats.nEnergy, 0);
+  EXPECT_EQ(s.stats.nCalls[Stats::POTENTIAL], 0);
+}
+
+
+TEST(StateTest, TestHessianVector) {
+  // Analytic (LjNd) and finite difference (function potential) Hessian-vector products
+  Lj3d lj;
+  Potential quartic([](const Vector& x, double* e, Vector* g){
+    if (e) *e = vec::sum(vec::pow(x, 4));
+    if (g) *g = 4 * vec::pow(x, 3);
+  });
+  Vector coords = {0,0,0, 1.2,0,0, 0,1.1,0, 0.1,0,1.3};
+  Vector v = {0.3,-0.2,0.1, 0.5,0.2,-0.4, -0.1,0.3,0.2, 0.2,-0.3,0.1};
+  for (Potential* pot : vector<Potential*>{&lj, &quartic}) {
+    State s = pot->newState(coords);
+    double eps = 1e-6;
+    Vector hvFD = (s.gradient(coords + eps*v) - s.gradient(coords - eps*v)) / (2*eps);
+    EXPECT_TRUE(ArraysNear(s.hessianVector(v), hvFD, 1e-4));
+  }
+}
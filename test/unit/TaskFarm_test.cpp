@@ -0,0 +1,79 @@
+// NPROCS 4
+#include "test_main.cpp"
+#include "TaskFarm.h"
+
+#include "State.h"
+#include "minimisers/Lbfgs.h"
+#include "potentials/LjNd.h"
+#include "utils/Philox.h"
+#include "utils/vec.h"
+#include "utils/mpi.h"
+
+using namespace minim;
+typedef std::vector<double> Vector;
+
+// Random starting coordinates for a 4 atom cluster
+Vector randomStart(int task) {
+  Vector init(12);
+  Philox(1, task).uniform(init, -1.5, 1.5);
+  return init;
+}
+
+
+TEST(TaskFarmTest, TestGroupRanks) {
+  EXPECT_EQ(TaskFarm(2).groupRanks(), std::vector<int>({mpi.rank/2*2, mpi.rank/2*2+1}));
+  EXPECT_EQ(TaskFarm(2).nGroup(), mpi.size/2);
+  EXPECT_THROW(TaskFarm(3).groupRanks(), std::invalid_argument);
+}
+
+
+TEST(TaskFarmTest, TestRandomStarts) {
+  Lj3d pot;
+  int nTask = 40;
+  TaskFarm farm;
+  State s = pot.newState(randomStart(0), farm.groupRanks());
+  int nReceived = 0;
+  farm.setOnResult([&](const TaskFarm::Result& result) { nReceived++; });
+  farm.run(s, Lbfgs(), nTask, [](int task, State& state) { state.coords(randomStart(task)); });
+
+  // Every task is minimised once, and the results are gathered on rank 0
+  EXPECT_EQ(mpi.sum(farm.nLocal), nTask);
+  EXPECT_GT(farm.throughput, 0);
+  if (mpi.rank != 0) return;
+  EXPECT_EQ(nReceived, nTask);
+  ASSERT_EQ((int)farm.results().size(), nTask);
+  for (int task : {0, 17, 39}) {
+    // The results match a minimisation of the same task on a single processor
+    const TaskFarm::Result& result = farm.results()[task];
+    EXPECT_EQ(result.task, task);
+    State ref = pot.newState(randomStart(task), {0});
+    Lbfgs min;
+    Vector coords = min.minimise(ref);
+    EXPECT_NEAR(result.energy, ref.energy(), 1e-10) << task;
+    EXPECT_TRUE(ArraysNear(result.coords, coords, 1e-10)) << task;
+  }
+}
+
+
+TEST(TaskFarmTest, TestGroups) {
+  // Parameter sweep with two processors per group, with a small chunk so that there are many chunks to share
+  Potential pot([](const Vector& x, double* e, Vector* g) {
+    if (e) *e = pow(x[0]-x[2], 2) + pow(x[1]-x[2]*x[2], 2);
+    if (g) *g = {2*(x[0]-x[2]), 2*(x[1]-x[2]*x[2]), 0};
+  });
+  pot.setConstraints({2}); // The parameter is fixed
+  TaskFarm farm(2);
+  farm.setChunk(2).setGatherCoords(false);
+  State s = pot.newState({0, 0, 0}, farm.groupRanks());
+  int nTask = 50;
+  farm.run(s, Lbfgs(), nTask, [](int task, State& state) { state.coords({1, 1, 0.1*task}); });
+
+  EXPECT_EQ(mpi.sum(farm.nLocal), 2*nTask);
+  if (mpi.rank != 0) return;
+  ASSERT_EQ((int)farm.results().size(), nTask);
+  for (int task=0; task<nTask; task++) {
+    EXPECT_EQ(farm.results()[task].task, task);
+    EXPECT_NEAR(farm.results()[task].energy, 0, 1e-8);
+    EXPECT_TRUE(farm.results()[task].coords.empty());
+  }
+}
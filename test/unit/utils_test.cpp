@@ -1,5 +1,6 @@
 #include "test_main.cpp"
 #include "utils/range.h"
+#include "utils/Philox.h"
 
 using namespace minim;
 
@@ -46,3 +47,38 @@ TEST(RangeTest, RangeISizeHalo) {
   }
   EXPECT_TRUE(ArraysMatch(is, {26, 27, 28, 31, 32, 33, 46, 47, 48, 51, 52, 53}));
 }
+
+
+TEST(PhiloxTest, KnownAnswers) {
+  // Test vectors from the Random123 library
+  EXPECT_EQ(Philox::block({0, 0, 0, 0}, {0, 0}), Philox::Block({0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+  EXPECT_EQ(Philox::block({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}),
+            Philox::Block({0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+  EXPECT_EQ(Philox::block({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}),
+            Philox::Block({0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+}
+
+
+TEST(PhiloxTest, Steps) {
+  // The numbers for a step do not depend on the numbers drawn before it
+  Philox a(7, 1), b(7, 1);
+  for (int i=0; i<5; i++) a();
+  a.setStep(3);
+  b.setStep(3);
+  for (int i=0; i<10; i++) EXPECT_EQ(a(), b());
+
+  // Batched numbers are reproducible and in range
+  std::vector<double> x(37), y(37);
+  a.setStep(4).uniform(x, -2, 3);
+  b.setStep(4).uniform(y, -2, 3);
+  EXPECT_EQ(x, y);
+  for (double xi : x) {
+    EXPECT_GE(xi, -2);
+    EXPECT_LT(xi, 3);
+  }
+
+  // Different streams give different numbers
+  Philox c(7, 2);
+  c.setStep(4).uniform(y, -2, 3);
+  EXPECT_NE(x, y);
+}